@@ -13,6 +13,12 @@ const { Server } = require("socket.io");
 const MazeNode = require('../build/Release/MazeNode');
 const fs = require('fs');
 
+// the exits of new mazes, reaching one of them sends the player on to the next maze
+const maze_goals = [{x: 20, y: 20}];
+
+// keep a few mazes ready so new_maze() does not stall the event loop
+MazeNode.configurePool({size: 4, width: 21, height: 21, goals: maze_goals, quantized: true});
+
 ////////////// Start ///////////////////////////////
 
 const app = express();
@@ -33,9 +39,10 @@ let map_filenames = {
 
 class Maze
 {
-    constructor(maze_id, start_points)
+    constructor(maze_id, start_points, goals)
     {
         this.maze_id = maze_id;
+        this.goals = goals;
         this.start_points = {};
         this.start_points.gold = start_points[0];
         this.start_points.green = start_points[1];
@@ -53,6 +60,11 @@ class Maze
         
     }
     
+    is_goal(x, y)
+    {
+        return this.goals.some(goal => goal.x == x && goal.y == y);
+    }
+    
     add_user(user)
     {
         this.users[user.id] = user;
@@ -81,7 +93,8 @@ fs.readFile("mazes.json", (err, data)=>{
     arr_mazes_static = JSON.parse(data);
     for (let record of arr_mazes_static)
     {
-        let maze = new Maze(record.maze_id, record.start_points);
+        // records from before goals were kept have the bottom right corner
+        let maze = new Maze(record.maze_id, record.start_points, record.goals || [{x: 20, y: 20}]);
         arr_mazes.push(maze);
     }
 });
@@ -157,14 +170,16 @@ io.on('connection', (socket) => {
         
         const new_maze = ()=>{
             maze_id = arr_mazes.length;
-            let arr = MazeNode.createAMaze(`maze_${maze_id}.glb`, 21,21);
-            let maze = new Maze(maze_id, arr);
+            let result = MazeNode.createAMaze(`maze_${maze_id}.glb`, 21,21, {goals: maze_goals, quantized: true});
+            let maze = new Maze(maze_id, result.start_points, maze_goals);
             arr_mazes.push(maze);
             join_maze(maze_id);
             
             let record = {
                 maze_id: maze_id,
-                start_points: arr
+                seed: result.seed,
+                start_points: result.start_points,
+                goals: maze_goals
             };
             arr_mazes_static.push(record);
             fs.writeFile("mazes.json", JSON.stringify(arr_mazes_static), (err) => 
@@ -192,7 +207,7 @@ io.on('connection', (socket) => {
                 let avatar_status = JSON.parse(msg);
                 if (avatar_status.maze_id != maze_id) return;
                 let position =  avatar_status.position;
-                if (Math.floor((31.5 + position.x)/3)==20 && Math.floor((31.5 -position.z)/3)==20)
+                if (maze.is_goal(Math.floor((31.5 + position.x)/3), Math.floor((31.5 -position.z)/3)))
                 {
                     maze.remove_user(user);
                     maze.emit_info(io);
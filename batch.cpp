@@ -0,0 +1,158 @@
+#include <cstdio>
+#include "batch.h"
+#include "fixed_maze.h"
+#include "maze_model.h"
+#include "start_placement.h"
+#include "thread_pool.h"
+
+// no goals, or only the bottom right corner
+static bool corner_goal(const MazeRequest& request)
+{
+	if (request.goals.empty()) return true;
+	return request.goals.size() == 1 && request.goals[0].x == request.width - 1 && request.goals[0].y == request.height - 1;
+}
+
+// the farthest cells from the request's goals
+static void analyze_goals(const MazeRequest& request, Maze& maze, MazeResult& result)
+{
+	if (request.goals.empty())
+	{
+		maze.analyze(result.start_points);
+		return;
+	}
+	maze.analyze(result.start_points, 6, request.goals);
+	if (request.distances) maze.take_nearest_goals(result.nearest_goals);
+}
+
+// fixed mazes are only built for the corner goal, every cell reached is nearest to it
+template <int W, int H>
+static void analyze_goals(const MazeRequest& request, FixedMaze<W, H>& maze, MazeResult& result)
+{
+	maze.analyze(result.start_points);
+	if (request.distances && !request.goals.empty())
+	{
+		maze.take_distances(result.nearest_goals);
+		for (uint32_t& nearest : result.nearest_goals)
+		{
+			if (nearest != Maze::UNREACHED) nearest = 0;
+		}
+	}
+}
+
+// Start points, the 6 farthest cells or a fair placement when the maze has one,
+// and the distances if asked for
+template <class MazeType>
+static void find_start_points(const MazeRequest& request, MazeType& maze, MazeResult& result)
+{
+	analyze_goals(request, maze, result);
+	if (!request.fair_starts && !request.distances) return;
+
+	std::vector<uint32_t> distances;
+	maze.take_distances(distances);
+	if (request.fair_starts)
+	{
+		StartPlacement placement;
+		placement.place(maze, distances, 6, result.start_points);
+	}
+	if (request.distances) result.distances.swap(distances);
+}
+
+template <int W, int H>
+static std::unique_ptr<MazeModel> build_fixed_model(const MazeRequest& request, MazeResult& result)
+{
+	FixedMaze<W, H> maze(request.seed);
+	find_start_points(request, maze, result);
+	measure(maze, result.metrics);
+	result.seed = request.seed;
+
+	std::unique_ptr<MazeModel> model(new MazeModel(W, H, request.mesh));
+	model->add_maze(maze);
+	return model;
+}
+
+static std::unique_ptr<MazeModel> build_model(const MazeRequest& request, ThreadPool* pool, MazeResult& result)
+{
+	if (request.difficulty.active() && request.tile_size <= 0)
+	{
+		DifficultySearch search;
+		find_maze(request.width, request.height, request.algorithm, request.seed, request.difficulty, request.goals, pool, search);
+		find_start_points(request, *search.maze, result);
+		result.seed = search.maze->m_seed;
+		result.metrics = search.metrics;
+		result.met_target = search.met_target;
+
+		std::unique_ptr<MazeModel> model(new MazeModel(request.width, request.height, request.mesh));
+		model->add_maze(*search.maze);
+		return model;
+	}
+
+	// the sizes the server asks for get a compile-time specialized Kruskal maze
+	if (request.algorithm == MazeAlgorithm::Kruskal && request.tile_size <= 0 && corner_goal(request) && request.width == request.height)
+	{
+		switch (request.width)
+		{
+		case 11: return build_fixed_model<11, 11>(request, result);
+		case 21: return build_fixed_model<21, 21>(request, result);
+		case 31: return build_fixed_model<31, 31>(request, result);
+		}
+	}
+
+	std::unique_ptr<MazeGenerator> generator;
+	if (request.tile_size > 0)
+	{
+		generator.reset(new TiledGenerator(request.algorithm, request.tile_size, pool));
+	}
+	else
+	{
+		generator = MazeGenerator::create(request.algorithm);
+	}
+
+	Maze maze(request.width, request.height, request.seed, *generator);
+	find_start_points(request, maze, result);
+	measure(maze, result.metrics, request.goals);
+	result.seed = request.seed;
+
+	std::unique_ptr<MazeModel> model(new MazeModel(request.width, request.height, request.mesh));
+	model->add_maze(maze);
+	return model;
+}
+
+void build_maze(const MazeRequest& request, ThreadPool* pool, MazeResult& result)
+{
+	result.saved = build_model(request, pool, result)->save(request.path);
+}
+
+void build_maze(const MazeRequest& request, ThreadPool* pool, MazeResult& result, std::vector<unsigned char>& glb)
+{
+	result.saved = build_model(request, pool, result)->save(glb);
+}
+
+bool write_file(const std::string& path, const std::vector<unsigned char>& data)
+{
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (fp == nullptr) return false;
+	size_t written = fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+	return written == data.size();
+}
+
+void build_mazes(const std::vector<MazeRequest>& requests, ThreadPool* pool, std::vector<MazeResult>& results)
+{
+	results.resize(requests.size());
+	auto build = [&](int i)
+	{
+		build_maze(requests[i], pool, results[i]);
+	};
+
+	if (pool != nullptr)
+	{
+		pool->parallel_for((int)requests.size(), build);
+	}
+	else
+	{
+		for (int i = 0; i < (int)requests.size(); i++)
+		{
+			build(i);
+		}
+	}
+}
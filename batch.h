@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "maze.h"
+#include "difficulty.h"
+#include "maze_model.h"
+
+class ThreadPool;
+
+// Everything needed to produce one maze file
+struct MazeRequest
+{
+	int width = 21;
+	int height = 21;
+	MazeAlgorithm algorithm = MazeAlgorithm::Kruskal;
+	uint64_t seed = 0;
+	int tile_size = 0;
+
+	// when active, the first candidate seed meeting it is used instead of seed (untiled mazes only)
+	DifficultyTarget difficulty;
+
+	// hand back the distance of every cell to the goal
+	bool distances = false;
+
+	// start points at one distance from the goal, spread apart (see StartPlacement),
+	// instead of the farthest cells
+	bool fair_starts = true;
+
+	// exits of the maze, the bottom right corner if empty. Start points,
+	// distances, metrics and difficulty targets are then to the nearest goal.
+	std::vector<Maze::CellLocation> goals;
+
+	MeshOptions mesh;
+
+	std::string path;
+};
+
+struct MazeResult
+{
+	uint64_t seed = 0;
+	std::vector<Maze::CellLocation> start_points;
+	bool saved = false;
+
+	MazeMetrics metrics;
+
+	// false if a difficulty target could not be met
+	bool met_target = true;
+
+	// for requests asking for distances: x + y * width, Maze::UNREACHED if not connected
+	std::vector<uint32_t> distances;
+
+	// for requests with goals asking for distances: the index in goals of each cell's nearest goal
+	std::vector<uint32_t> nearest_goals;
+};
+
+// Generates, analyzes, meshes and writes one maze.
+// Tiles of a tiled maze are spread over the pool when one is given.
+void build_maze(const MazeRequest& request, ThreadPool* pool, MazeResult& result);
+
+// Same as build_maze, keeping the glb in memory instead of writing request.path
+void build_maze(const MazeRequest& request, ThreadPool* pool, MazeResult& result, std::vector<unsigned char>& glb);
+
+bool write_file(const std::string& path, const std::vector<unsigned char>& data);
+
+// Builds every request, one maze per task on the pool
+void build_mazes(const std::vector<MazeRequest>& requests, ThreadPool* pool, std::vector<MazeResult>& results);
@@ -0,0 +1,1143 @@
+#include <ctime>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <vector>
+#include <string>
+#include <queue>
+#include <sstream>
+
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include <tiny_gltf.h>
+
+#include "maze.h"
+#include "fixed_maze.h"
+#include "batch.h"
+#include "difficulty.h"
+#include "bitboard_bfs.h"
+#include "maze_index.h"
+#include "maze_metrics.h"
+#include "maze_model.h"
+#include "geometry.h"
+#include "thread_pool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// every heap allocation of the process, for the mesh bench
+static std::atomic<size_t> s_allocations(0);
+
+void* operator new(size_t size)
+{
+	s_allocations++;
+	void* p = malloc(size != 0 ? size : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static double elapsed_ms(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// The original generator: rescans all walls and relabels all cells per removed wall.
+static void generate_legacy(int w, int h, std::vector<bool>& x_walls, std::vector<bool>& y_walls)
+{
+	struct Wall
+	{
+		bool dir;
+		int x;
+		int y;
+	};
+
+	std::vector<int> cell_id(w * h);
+	for (int i = 0; i < w * h; i++)
+	{
+		cell_id[i] = i;
+	}
+
+	x_walls.assign((w - 1) * h, true);
+	y_walls.assign(w * (h - 1), true);
+
+	auto get_cell_ids = [&](const Wall& wall, int& id0, int& id1)
+	{
+		id0 = cell_id[wall.x + wall.y * w];
+		id1 = wall.dir ? cell_id[wall.x + (wall.y + 1) * w] : cell_id[wall.x + 1 + wall.y * w];
+	};
+
+	while (true)
+	{
+		std::vector<Wall> active_walls;
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w - 1; x++)
+			{
+				Wall wall = { false, x, y };
+				int id0, id1;
+				get_cell_ids(wall, id0, id1);
+				if (id0 != id1) active_walls.push_back(wall);
+			}
+		}
+		for (int y = 0; y < h - 1; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				Wall wall = { true, x, y };
+				int id0, id1;
+				get_cell_ids(wall, id0, id1);
+				if (id0 != id1) active_walls.push_back(wall);
+			}
+		}
+		if (active_walls.size() < 1) break;
+
+		Wall& wall = active_walls[rand() % (int)active_walls.size()];
+		if (!wall.dir)
+		{
+			x_walls[wall.x + wall.y * (w - 1)] = false;
+		}
+		else
+		{
+			y_walls[wall.x + wall.y * w] = false;
+		}
+
+		int id0, id1;
+		get_cell_ids(wall, id0, id1);
+		if (id0 > id1)
+		{
+			int tmp = id0;
+			id0 = id1;
+			id1 = tmp;
+		}
+		for (int i = 0; i < w * h; i++)
+		{
+			if (cell_id[i] == id1) cell_id[i] = id0;
+		}
+	}
+}
+
+// The original analysis: a std::queue of nodes and one vector of nodes per distance
+static void analyze_legacy(const Maze& maze, std::vector<Maze::CellLocation>& farthests)
+{
+	struct Node
+	{
+		int x;
+		int y;
+		int steps;
+	};
+
+	int w = maze.m_width;
+	std::vector<int> cell_steps(w * maze.m_height, 0x7FFFFFFF);
+	std::queue<Node> queue;
+	queue.push({ w - 1, maze.m_height - 1, 0 });
+	std::vector<std::vector<Node>> classes;
+
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+	while (queue.size() > 0)
+	{
+		Node node = queue.front();
+		queue.pop();
+		if (node.steps >= (int)classes.size()) classes.resize(node.steps + 1);
+		classes[node.steps].push_back(node);
+
+		unsigned dirs = maze.open_dirs(node.x, node.y);
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if ((dirs & (1u << dir)) == 0) continue;
+			int next = node.x + dx[dir] + (node.y + dy[dir]) * w;
+			if (cell_steps[next] > node.steps + 1)
+			{
+				cell_steps[next] = node.steps + 1;
+				queue.push({ node.x + dx[dir], node.y + dy[dir], node.steps + 1 });
+			}
+		}
+	}
+
+	farthests.clear();
+	for (size_t i = classes.size() - 1; i != (size_t)(-1) && farthests.size() < 6; i--)
+	{
+		for (size_t j = 0; j < classes[i].size() && farthests.size() < 6; j++)
+		{
+			farthests.push_back({ classes[i][j].x, classes[i][j].y });
+		}
+	}
+}
+
+static void bench_generate()
+{
+	printf("generate: legacy Kruskal vs union-find Kruskal\n");
+	printf("%8s %14s %14s %10s\n", "size", "legacy(ms)", "union-find(ms)", "speedup");
+
+	const int sizes[] = { 21, 101, 1001, 4001 };
+	for (int size : sizes)
+	{
+		// the legacy path is quadratic, anything above 101 takes hours
+		double t_legacy = -1.0;
+		if (size <= 101)
+		{
+			std::vector<bool> x_walls, y_walls;
+			Clock::time_point t0 = Clock::now();
+			generate_legacy(size, size, x_walls, y_walls);
+			t_legacy = elapsed_ms(t0);
+		}
+
+		Clock::time_point t0 = Clock::now();
+		Maze maze(size, size, Random::random_seed());
+		double t_new = elapsed_ms(t0);
+
+		if (t_legacy >= 0.0)
+		{
+			printf("%8d %14.3f %14.3f %9.1fx\n", size, t_legacy, t_new, t_legacy / t_new);
+		}
+		else
+		{
+			printf("%8d %14s %14.3f %10s\n", size, "skipped", t_new, "-");
+		}
+	}
+}
+
+static void bench_algorithms()
+{
+	printf("algorithms: generation time (ms)\n");
+
+	const int sizes[] = { 21, 101, 1001, 2001 };
+	printf("%14s", "algorithm");
+	for (int size : sizes)
+	{
+		printf(" %10d", size);
+	}
+	printf("\n");
+
+	for (int a = (int)MazeAlgorithm::Kruskal; a <= (int)MazeAlgorithm::HuntAndKill; a++)
+	{
+		MazeAlgorithm algorithm = (MazeAlgorithm)a;
+		printf("%14s", algorithm_name(algorithm));
+		for (int size : sizes)
+		{
+			Clock::time_point t0 = Clock::now();
+			Maze maze(size, size, Random::random_seed(), algorithm);
+			printf(" %10.3f", elapsed_ms(t0));
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+}
+
+static void bench_tiled()
+{
+	const int size = 4001;
+	const int tile_size = 256;
+	printf("tiled: %dx%d maze, %d-cell tiles, kruskal\n", size, size, tile_size);
+	printf("%8s %12s %14s %10s\n", "threads", "time(ms)", "Mcells/s", "scaling");
+
+	double t_single = 0.0;
+	int max_threads = ThreadPool::hardware_threads();
+	for (int num_threads = 1; num_threads <= max_threads; num_threads++)
+	{
+		// the calling thread is one of the workers
+		std::unique_ptr<ThreadPool> pool;
+		if (num_threads > 1) pool.reset(new ThreadPool(num_threads - 1));
+		TiledGenerator generator(MazeAlgorithm::Kruskal, tile_size, pool.get());
+
+		Clock::time_point t0 = Clock::now();
+		Maze maze(size, size, Random::random_seed(), generator);
+		double t = elapsed_ms(t0);
+		if (num_threads == 1) t_single = t;
+
+		printf("%8d %12.3f %14.3f %9.2fx\n", num_threads, t, (double)size * size / t / 1000.0, t_single / t);
+	}
+}
+
+static void bench_batch()
+{
+	const int count = 64;
+	printf("batch: %d mazes of 21x21, generated, analyzed, meshed and written\n", count);
+	printf("%8s %12s %12s %10s\n", "threads", "time(ms)", "mazes/s", "scaling");
+
+	std::vector<MazeRequest> requests(count);
+	for (int i = 0; i < count; i++)
+	{
+		requests[i].seed = Random::random_seed();
+		requests[i].path = "bench_batch_" + std::to_string(i) + ".glb";
+	}
+
+	double t_single = 0.0;
+	int max_threads = ThreadPool::hardware_threads();
+	for (int num_threads = 1; num_threads <= max_threads; num_threads++)
+	{
+		std::unique_ptr<ThreadPool> pool;
+		if (num_threads > 1) pool.reset(new ThreadPool(num_threads - 1));
+
+		std::vector<MazeResult> results;
+		Clock::time_point t0 = Clock::now();
+		build_mazes(requests, pool.get(), results);
+		double t = elapsed_ms(t0);
+		if (num_threads == 1) t_single = t;
+
+		printf("%8d %12.3f %12.1f %9.2fx\n", num_threads, t, count / t * 1000.0, t_single / t);
+	}
+
+	for (auto& request : requests)
+	{
+		remove(request.path.c_str());
+	}
+}
+
+static void bench_analyze()
+{
+	printf("analyze: 6 farthest cells, repeated analysis of one kruskal maze\n");
+	printf("%8s %8s %14s %14s %10s\n", "size", "repeats", "legacy(ms)", "ring+top-k(ms)", "speedup");
+
+	const int sizes[] = { 21, 101, 1001, 2001 };
+	const int repeats[] = { 2000, 200, 5, 2 };
+	for (int s = 0; s < 4; s++)
+	{
+		Maze maze(sizes[s], sizes[s], Random::random_seed());
+		std::vector<Maze::CellLocation> legacy_points, points;
+
+		// warm up the scratch buffers
+		maze.analyze(points);
+
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < repeats[s]; i++)
+		{
+			analyze_legacy(maze, legacy_points);
+		}
+		double t_legacy = elapsed_ms(t0);
+
+		t0 = Clock::now();
+		for (int i = 0; i < repeats[s]; i++)
+		{
+			maze.analyze(points);
+		}
+		double t_new = elapsed_ms(t0);
+
+		bool same = legacy_points.size() == points.size();
+		for (size_t i = 0; same && i < points.size(); i++)
+		{
+			same = legacy_points[i].x == points[i].x && legacy_points[i].y == points[i].y;
+		}
+		printf("%8d %8d %14.3f %14.3f %9.2fx%s\n", sizes[s], repeats[s], t_legacy, t_new, t_legacy / t_new, same ? "" : " RESULTS DIFFER");
+	}
+}
+
+static void bench_bitboard()
+{
+	printf("bitboard: queue BFS vs bit row BFS, distances and 6 farthest cells\n");
+	printf("%14s %8s %12s %14s %12s\n", "algorithm", "size", "queue(ms)", "portable(ms)", "avx2(ms)");
+
+	const MazeAlgorithm algorithms[] = { MazeAlgorithm::Kruskal, MazeAlgorithm::Backtracker, MazeAlgorithm::Prim };
+	const int sizes[] = { 1001, 2001, 4001 };
+	for (MazeAlgorithm algorithm : algorithms)
+	{
+		for (int size : sizes)
+		{
+			Maze maze(size, size, Random::random_seed(), algorithm);
+			Maze::CellLocation goal = { size - 1, size - 1 };
+			std::vector<Maze::CellLocation> points;
+			std::vector<uint32_t> distances;
+
+			Clock::time_point t0 = Clock::now();
+			maze.analyze(points, 6, goal);
+			double t_queue = elapsed_ms(t0);
+			maze.take_distances(distances);
+
+			BitboardBFS bfs;
+			double t_bits[2] = { -1.0, -1.0 };
+			bool same = true;
+			for (int avx2 = 0; avx2 < 2; avx2++)
+			{
+				if (avx2 && !BitboardBFS::cpu_has_avx2()) continue;
+				bfs.set_use_avx2(avx2 != 0);
+
+				std::vector<Maze::CellLocation> bit_points;
+				std::vector<uint32_t> bit_distances;
+				t0 = Clock::now();
+				bfs.run(maze, goal, bit_distances);
+				bfs.farthest(maze, bit_distances, 6, bit_points);
+				t_bits[avx2] = elapsed_ms(t0);
+
+				same = same && bit_distances == distances && bit_points.size() == points.size();
+				for (size_t i = 0; same && i < points.size(); i++)
+				{
+					same = bit_points[i].x == points[i].x && bit_points[i].y == points[i].y;
+				}
+			}
+
+			printf("%14s %8d %12.3f %14.3f ", algorithm_name(algorithm), size, t_queue, t_bits[0]);
+			if (t_bits[1] >= 0.0) printf("%12.3f", t_bits[1]);
+			else printf("%12s", "n/a");
+			printf("%s\n", same ? "" : " RESULTS DIFFER");
+		}
+	}
+}
+
+// Walls and all start points of FixedMaze against Maze for each seed. Production
+// serves these sizes from FixedMaze while MazeIndex rebuilds them with Maze.
+template <int W, int H>
+static int fixed_mismatches(const std::vector<uint64_t>& seeds)
+{
+	int mismatches = 0;
+	std::vector<Maze::CellLocation> dynamic_points, fixed_points;
+	std::vector<uint32_t> dynamic_distances, fixed_distances;
+	for (uint64_t seed : seeds)
+	{
+		Maze maze(W, H, seed);
+		FixedMaze<W, H> fixed(seed);
+		maze.analyze(dynamic_points);
+		fixed.analyze(fixed_points);
+		maze.take_distances(dynamic_distances);
+		fixed.take_distances(fixed_distances);
+
+		bool same = dynamic_points.size() == fixed_points.size() && dynamic_distances == fixed_distances;
+		for (size_t i = 0; same && i < dynamic_points.size(); i++)
+		{
+			same = dynamic_points[i].x == fixed_points[i].x && dynamic_points[i].y == fixed_points[i].y;
+		}
+		for (int y = 0; same && y < H; y++)
+		{
+			for (int x = 0; same && x < W; x++)
+			{
+				if (x < W - 1 && maze.has_x_wall(x, y) != fixed.has_x_wall(x, y)) same = false;
+				if (y < H - 1 && maze.has_y_wall(x, y) != fixed.has_y_wall(x, y)) same = false;
+			}
+		}
+		if (!same) mismatches++;
+	}
+	return mismatches;
+}
+
+static void bench_fixed()
+{
+	const int count = 20000;
+	printf("fixed: %d 21x21 Kruskal mazes generated and analyzed\n", count);
+	printf("%10s %12s %14s %14s\n", "maze", "time(ms)", "us/maze", "analyze us");
+
+	std::vector<uint64_t> seeds(count);
+	for (int i = 0; i < count; i++)
+	{
+		seeds[i] = Random::random_seed();
+	}
+
+	// the farthest x summed keeps the work from being optimized out
+	std::vector<Maze::CellLocation> points;
+	int checksum = 0;
+
+	Clock::time_point t0 = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		Maze maze(21, 21, seeds[i]);
+		maze.analyze(points);
+		checksum += points[0].x;
+	}
+	double t_dynamic = elapsed_ms(t0);
+
+	t0 = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		FixedMaze<21, 21> maze(seeds[i]);
+		maze.analyze(points);
+		checksum += points[0].x;
+	}
+	double t_fixed = elapsed_ms(t0);
+
+	// the BFS alone, on one maze of each kind
+	const int repeats = 200;
+	Maze maze(21, 21, seeds[0]);
+	FixedMaze<21, 21> fixed(seeds[0]);
+	t0 = Clock::now();
+	for (int i = 0; i < count / repeats; i++)
+	{
+		for (int j = 0; j < repeats; j++)
+		{
+			maze.analyze(points);
+			checksum += points[0].x;
+		}
+	}
+	double t_dynamic_bfs = elapsed_ms(t0);
+
+	t0 = Clock::now();
+	for (int i = 0; i < count / repeats; i++)
+	{
+		for (int j = 0; j < repeats; j++)
+		{
+			fixed.analyze(points);
+			checksum += points[0].x;
+		}
+	}
+	double t_fixed_bfs = elapsed_ms(t0);
+
+	printf("%10s %12.3f %14.3f %14.3f\n", "Maze", t_dynamic, t_dynamic * 1000.0 / count, t_dynamic_bfs * 1000.0 / count);
+	printf("%10s %12.3f %14.3f %14.3f\n", "FixedMaze", t_fixed, t_fixed * 1000.0 / count, t_fixed_bfs * 1000.0 / count);
+	printf("speedup %.2fx, analyze %.2fx (checksum %d)\n", t_dynamic / t_fixed, t_dynamic_bfs / t_fixed_bfs, checksum);
+
+	int mismatches = fixed_mismatches<11, 11>(seeds) + fixed_mismatches<21, 21>(seeds) + fixed_mismatches<31, 31>(seeds);
+	printf("11x11, 21x21, 31x31: %d of %d seeds differ from Maze in walls or start points%s\n",
+		mismatches, 3 * count, mismatches != 0 ? ", RESULTS DIFFER" : "");
+}
+
+static void bench_difficulty()
+{
+	const int count = 50;
+	DifficultyTarget target;
+	target.solution_length.min = 100;
+	target.dead_ends.max = 130;
+	printf("difficulty: %d 21x21 kruskal mazes with solution length >= %d and at most %d dead ends\n",
+		count, target.solution_length.min, target.dead_ends.max);
+	printf("%22s %12s %12s %12s %10s\n", "search", "time(ms)", "ms/maze", "candidates", "abandoned");
+
+	std::vector<uint64_t> seeds(count);
+	for (int i = 0; i < count; i++)
+	{
+		seeds[i] = Random::random_seed();
+	}
+
+	// serial retries, each candidate fully generated and measured
+	{
+		int candidates = 0;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			Random rng(seeds[i]);
+			uint64_t seed = seeds[i];
+			for (int c = 0; c < target.max_candidates; c++)
+			{
+				candidates++;
+				Maze maze(21, 21, seed);
+				MazeMetrics metrics;
+				measure(maze, metrics);
+				if (target.accepts(metrics)) break;
+				seed = rng.next() & Random::max_seed;
+			}
+		}
+		double t = elapsed_ms(t0);
+		printf("%22s %12.3f %12.3f %12d %10s\n", "retry", t, t / count, candidates, "-");
+	}
+
+	int max_threads = ThreadPool::hardware_threads();
+	for (int num_threads = 1; num_threads <= max_threads; num_threads++)
+	{
+		std::unique_ptr<ThreadPool> pool;
+		if (num_threads > 1) pool.reset(new ThreadPool(num_threads - 1));
+
+		int candidates = 0;
+		int abandoned = 0;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			DifficultySearch search;
+			find_maze(21, 21, MazeAlgorithm::Kruskal, seeds[i], target, std::vector<Maze::CellLocation>(), pool.get(), search);
+			candidates += search.candidates;
+			abandoned += search.abandoned;
+		}
+		double t = elapsed_ms(t0);
+
+		std::string name = "find_maze " + std::to_string(num_threads) + " thread" + (num_threads > 1 ? "s" : "");
+		printf("%22s %12.3f %12.3f %12d %10d\n", name.c_str(), t, t / count, candidates, abandoned);
+	}
+}
+
+static void bench_index()
+{
+	printf("index: distance between random cell pairs, a BFS per query vs MazeIndex\n");
+	printf("%8s %12s %10s %14s %10s %14s %10s\n", "size", "build(ms)", "bfs runs", "us/bfs query", "queries", "ns/query", "speedup");
+
+	const int sizes[] = { 101, 1001, 2001 };
+	const int bfs_runs[] = { 2000, 20, 5 };
+	const int queries = 1000000;
+	for (int s = 0; s < 3; s++)
+	{
+		int size = sizes[s];
+		Maze maze(size, size, Random::random_seed());
+
+		Random rng(Random::random_seed());
+		std::vector<Maze::CellLocation> pairs(queries * 2);
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			pairs[i] = { (int)(rng.next() % size), (int)(rng.next() % size) };
+		}
+
+		Clock::time_point t0 = Clock::now();
+		MazeIndex index(maze);
+		double t_build = elapsed_ms(t0);
+
+		// the BFS answers a query by running from one end and reading the other
+		std::vector<Maze::CellLocation> points;
+		std::vector<uint32_t> distances;
+		bool same = true;
+		t0 = Clock::now();
+		for (int i = 0; i < bfs_runs[s]; i++)
+		{
+			Maze::CellLocation a = pairs[i * 2];
+			Maze::CellLocation b = pairs[i * 2 + 1];
+			maze.analyze(points, 1, b);
+			maze.take_distances(distances);
+			same = same && (int)distances[a.x + a.y * size] == index.distance(a, b);
+		}
+		double t_bfs = elapsed_ms(t0);
+
+		int64_t total = 0;
+		t0 = Clock::now();
+		for (int i = 0; i < queries; i++)
+		{
+			total += index.distance(pairs[i * 2], pairs[i * 2 + 1]);
+		}
+		double t_index = elapsed_ms(t0);
+
+		double us_bfs = t_bfs * 1000.0 / bfs_runs[s];
+		double ns_index = t_index * 1000000.0 / queries;
+		printf("%8d %12.3f %10d %14.3f %10d %14.3f %9.0fx%s\n", size, t_build, bfs_runs[s], us_bfs, queries, ns_index,
+			us_bfs * 1000.0 / ns_index, same && total > 0 ? "" : " RESULTS DIFFER");
+	}
+}
+
+// the measurement before the metrics kernel: a BFS for the solution length and
+// sweeps over the rows and columns, for 3 of the metrics
+static void measure_legacy(const Maze& maze, MazeMetrics& metrics)
+{
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+
+	int w = maze.m_width;
+	int h = maze.m_height;
+	std::vector<int> steps(w * h, -1);
+	std::vector<int> queue(w * h);
+	int goal = w * h - 1;
+	steps[goal] = 0;
+	queue[0] = goal;
+	int head = 0;
+	int tail = 1;
+	metrics.solution_length = 0;
+	while (head < tail)
+	{
+		int cell = queue[head++];
+		int x = cell % w;
+		int y = cell / w;
+		metrics.solution_length = steps[cell];
+
+		unsigned dirs = maze.open_dirs(x, y);
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if ((dirs & (1u << dir)) == 0) continue;
+			int next = x + dx[dir] + (y + dy[dir]) * w;
+			if (steps[next] >= 0) continue;
+			steps[next] = steps[cell] + 1;
+			queue[tail++] = next;
+		}
+	}
+
+	metrics.dead_ends = 0;
+	metrics.longest_corridor = 0;
+	for (int y = 0; y < h; y++)
+	{
+		int run = 1;
+		for (int x = 0; x < w; x++)
+		{
+			unsigned dirs = maze.open_dirs(x, y);
+			if ((dirs & (dirs - 1)) == 0) metrics.dead_ends++;
+
+			run = x > 0 && maze.is_open(x, y, Maze::DIR_NEG_X) ? run + 1 : 1;
+			if (run > metrics.longest_corridor) metrics.longest_corridor = run;
+		}
+	}
+	for (int x = 0; x < w; x++)
+	{
+		int run = 1;
+		for (int y = 1; y < h; y++)
+		{
+			run = maze.is_open(x, y, Maze::DIR_NEG_Y) ? run + 1 : 1;
+			if (run > metrics.longest_corridor) metrics.longest_corridor = run;
+		}
+	}
+}
+
+// Every metric found the slow way, to check the kernel against: subtree heights
+// from a BFS tree, the solution path walked down the tallest child (the first in
+// direction order on a tie, as the kernel takes it), a BFS from that path for the
+// branch depth, and a flood over the cells with two open sides for the rivers.
+static void measure_reference(const Maze& maze, MazeMetrics& metrics)
+{
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+
+	int w = maze.m_width;
+	int h = maze.m_height;
+	int num_cells = w * h;
+	// solution length and longest corridor as the legacy measurement has them
+	MazeMetrics legacy;
+	measure_legacy(maze, legacy);
+	metrics = MazeMetrics();
+	metrics.solution_length = legacy.solution_length;
+	metrics.longest_corridor = legacy.longest_corridor;
+
+	auto neighbor = [&](int cell, int dir) { return cell % w + dx[dir] + (cell / w + dy[dir]) * w; };
+	auto degree = [&](int cell)
+	{
+		unsigned dirs = maze.open_dirs(cell % w, cell / w);
+		return (int)(dirs & 1) + (int)((dirs >> 1) & 1) + (int)((dirs >> 2) & 1) + (int)((dirs >> 3) & 1);
+	};
+
+	// BFS tree from the goal, then heights from the leaves up
+	std::vector<int> parent(num_cells, -1);
+	std::vector<int> order;
+	std::vector<bool> seen(num_cells, false);
+	order.push_back(num_cells - 1);
+	seen[num_cells - 1] = true;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		int cell = order[i];
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if (!maze.is_open(cell % w, cell / w, dir)) continue;
+			int next = neighbor(cell, dir);
+			if (seen[next]) continue;
+			seen[next] = true;
+			parent[next] = cell;
+			order.push_back(next);
+		}
+	}
+	std::vector<int> height(num_cells, 0);
+	for (size_t i = order.size(); i-- > 1;)
+	{
+		int cell = order[i];
+		height[parent[cell]] = std::max(height[parent[cell]], height[cell] + 1);
+	}
+
+	std::vector<int> path(1, num_cells - 1);
+	while (height[path.back()] > 0)
+	{
+		int cell = path.back();
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if (!maze.is_open(cell % w, cell / w, dir)) continue;
+			int next = neighbor(cell, dir);
+			if (parent[next] != cell || height[next] + 1 != height[cell]) continue;
+			path.push_back(next);
+			break;
+		}
+	}
+	metrics.solution_cells = (int)path.size();
+
+	std::vector<int> steps(num_cells, -1);
+	std::vector<int> queue(path);
+	for (int cell : path) steps[cell] = 0;
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		int cell = queue[i];
+		metrics.max_branch_depth = steps[cell];
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if (!maze.is_open(cell % w, cell / w, dir)) continue;
+			int next = neighbor(cell, dir);
+			if (steps[next] >= 0) continue;
+			steps[next] = steps[cell] + 1;
+			queue.push_back(next);
+		}
+	}
+
+	std::vector<bool> flooded(num_cells, false);
+	for (int cell = 0; cell < num_cells; cell++)
+	{
+		int d = degree(cell);
+		if (d == 1) metrics.dead_ends++;
+		if (d >= 3) metrics.junctions++;
+		if (d != 2 || flooded[cell]) continue;
+
+		uint32_t length = 0;
+		std::vector<int> river(1, cell);
+		flooded[cell] = true;
+		while (!river.empty())
+		{
+			int c = river.back();
+			river.pop_back();
+			length++;
+			for (int dir = 0; dir < 4; dir++)
+			{
+				if (!maze.is_open(c % w, c / w, dir)) continue;
+				int next = neighbor(c, dir);
+				if (flooded[next] || degree(next) != 2) continue;
+				flooded[next] = true;
+				river.push_back(next);
+			}
+		}
+		int bucket = 0;
+		while (length >>= 1) bucket++;
+		metrics.rivers[std::min(bucket, MazeMetrics::RIVER_BUCKETS - 1)]++;
+	}
+}
+
+static bool same_metrics(const MazeMetrics& a, const MazeMetrics& b)
+{
+	return a.solution_length == b.solution_length && a.solution_cells == b.solution_cells
+		&& a.max_branch_depth == b.max_branch_depth && a.dead_ends == b.dead_ends && a.junctions == b.junctions
+		&& a.longest_corridor == b.longest_corridor && a.rivers == b.rivers;
+}
+
+static void bench_metrics()
+{
+	printf("metrics: BFS and sweeps for 3 metrics vs the one pass kernel for all of them,\n");
+	printf("    every maze's metrics then checked against a brute force measurement of each\n");
+	printf("%14s %8s %8s %12s %12s %9s %8s\n", "algorithm", "size", "mazes", "legacy(ms)", "kernel(ms)", "speedup", "differ");
+
+	const MazeAlgorithm algorithms[] = { MazeAlgorithm::Kruskal, MazeAlgorithm::Backtracker };
+	const int sizes[] = { 21, 1001 };
+	const int counts[] = { 2000, 3 };
+	for (MazeAlgorithm algorithm : algorithms)
+	{
+		for (int s = 0; s < 2; s++)
+		{
+			std::vector<std::unique_ptr<Maze>> mazes;
+			for (int i = 0; i < counts[s]; i++)
+			{
+				mazes.emplace_back(new Maze(sizes[s], sizes[s], Random::random_seed(), algorithm));
+			}
+
+			MazeMetrics legacy;
+			std::vector<MazeMetrics> metrics(mazes.size());
+			Clock::time_point t0 = Clock::now();
+			for (const std::unique_ptr<Maze>& maze : mazes)
+			{
+				measure_legacy(*maze, legacy);
+			}
+			double t_legacy = elapsed_ms(t0);
+
+			MetricsKernel kernel;
+			t0 = Clock::now();
+			for (size_t i = 0; i < mazes.size(); i++)
+			{
+				kernel.measure(*mazes[i], metrics[i]);
+			}
+			double t_kernel = elapsed_ms(t0);
+
+			int differ = 0;
+			for (size_t i = 0; i < mazes.size(); i++)
+			{
+				MazeMetrics reference;
+				measure_reference(*mazes[i], reference);
+				if (!same_metrics(reference, metrics[i])) differ++;
+			}
+			printf("%14s %8d %8d %12.3f %12.3f %8.2fx %8d%s\n", algorithm_name(algorithm), sizes[s], counts[s],
+				t_legacy, t_kernel, t_legacy / t_kernel, differ, differ == 0 ? "" : " RESULTS DIFFER");
+		}
+	}
+}
+
+static void bench_solve()
+{
+	printf("solve: path from the farthest cell to the goal as a move string, after one analysis\n");
+	printf("%14s %8s %12s %10s %12s %10s\n", "algorithm", "size", "analyze(ms)", "steps", "solve(us)", "bytes");
+
+	const MazeAlgorithm algorithms[] = { MazeAlgorithm::Kruskal, MazeAlgorithm::Prim, MazeAlgorithm::Backtracker };
+	const int sizes[] = { 101, 1001 };
+	for (MazeAlgorithm algorithm : algorithms)
+	{
+		for (int size : sizes)
+		{
+			Maze maze(size, size, Random::random_seed(), algorithm);
+			std::vector<Maze::CellLocation> points;
+			Clock::time_point t0 = Clock::now();
+			maze.analyze(points, 1, { size - 1, size - 1 });
+			double t_analyze = elapsed_ms(t0);
+
+			const int repeats = 100;
+			std::vector<uint8_t> moves;
+			int steps = 0;
+			t0 = Clock::now();
+			for (int i = 0; i < repeats; i++)
+			{
+				steps = maze.solve(points[0], moves);
+			}
+			double t_solve = elapsed_ms(t0) * 1000.0 / repeats;
+
+			// replaying the moves has to reach the goal through open walls
+			static const int dx[4] = { -1, 1, 0, 0 };
+			static const int dy[4] = { 0, 0, -1, 1 };
+			Maze::CellLocation at = points[0];
+			bool valid = true;
+			for (int i = 0; i < steps && valid; i++)
+			{
+				int dir = (moves[i >> 2] >> ((i & 3) * 2)) & 3;
+				valid = maze.is_open(at.x, at.y, dir);
+				at.x += dx[dir];
+				at.y += dy[dir];
+			}
+			valid = valid && at.x == size - 1 && at.y == size - 1;
+
+			printf("%14s %8d %12.3f %10d %12.3f %10d%s\n", algorithm_name(algorithm), size, t_analyze, steps, t_solve,
+				(int)moves.size(), valid ? "" : " INVALID PATH");
+		}
+	}
+}
+
+// The original mesher: one primitive, with its own accessors, per ground tile, pillar and wall.
+static void add_piece_legacy(tinygltf::Model& m_out, Geometry& geo, int material)
+{
+	tinygltf::Primitive prim_out;
+	prim_out.material = material;
+	prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+	geo.to_gltf(m_out, prim_out);
+	m_out.meshes[0].primitives.emplace_back(prim_out);
+}
+
+static size_t count_triangles(const tinygltf::Model& model)
+{
+	size_t triangles = 0;
+	for (const tinygltf::Primitive& prim : model.meshes[0].primitives)
+	{
+		triangles += model.accessors[prim.indices].count / 3;
+	}
+	return triangles;
+}
+
+static void mesh_legacy_model(const Maze& maze, tinygltf::Model& m_out)
+{
+	int w = maze.m_width;
+	int h = maze.m_height;
+	int origin_x = -w * 48 / 2;
+	int origin_y = -h * 48 / 2;
+
+	m_out.scenes.resize(1);
+	m_out.asset.version = "2.0";
+	m_out.buffers.resize(1);
+	m_out.nodes.resize(1);
+	m_out.nodes[0].mesh = 0;
+	m_out.scenes[0].nodes.push_back(0);
+	m_out.meshes.resize(1);
+
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			Geometry ground;
+			ground.generate_ground(48, 48, origin_x + x * 48, 0, origin_y + y * 48);
+			add_piece_legacy(m_out, ground, 0);
+		}
+	}
+	for (int y = 0; y <= h; y++)
+	{
+		for (int x = 0; x <= w; x++)
+		{
+			Geometry pillar;
+			pillar.generate_pillar(8, 26, 8, origin_x + x * 48 - 4, 0, origin_y + y * 48 - 4);
+			add_piece_legacy(m_out, pillar, 1);
+		}
+	}
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x <= w; x++)
+		{
+			if (x > 0 && x < w && !maze.has_x_wall(x - 1, y)) continue;
+			Geometry wall;
+			wall.generate_wall_x(6, 24, 48, origin_x + x * 48 - 3, 0, origin_y + y * 48);
+			add_piece_legacy(m_out, wall, 2);
+		}
+	}
+	for (int y = 0; y <= h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			if (y > 0 && y < h && !maze.has_y_wall(x, y - 1)) continue;
+			Geometry wall;
+			wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y + y * 48 - 3);
+			add_piece_legacy(m_out, wall, 2);
+		}
+	}
+}
+
+static void mesh_legacy(const Maze& maze, std::vector<unsigned char>& glb, size_t& primitives, size_t& triangles)
+{
+	tinygltf::Model m_out;
+	mesh_legacy_model(maze, m_out);
+
+	tinygltf::TinyGLTF gltf;
+	std::ostringstream stream;
+	gltf.WriteGltfSceneToStream(&m_out, stream, false, true);
+	std::string data = stream.str();
+	glb.assign(data.begin(), data.end());
+	primitives = m_out.meshes[0].primitives.size();
+	triangles = count_triangles(m_out);
+}
+
+static void bench_mesh()
+{
+	printf("mesh: maze to glb in memory, one primitive per piece (legacy) vs one per material and merged wall runs\n");
+	printf("%8s %12s %12s %8s %12s %12s %12s %12s %10s %10s %12s %12s\n", "size", "legacy(ms)", "merged(ms)", "speedup",
+		"legacy prims", "merged prims", "legacy tris", "merged tris", "legacy KB", "merged KB", "instanced KB", "quantized KB");
+
+	const int sizes[] = { 21, 101, 301 };
+	for (int size : sizes)
+	{
+		Maze maze(size, size, Random::random_seed());
+
+		std::vector<unsigned char> glb_legacy;
+		size_t legacy_primitives = 0;
+		size_t legacy_triangles = 0;
+		Clock::time_point t0 = Clock::now();
+		mesh_legacy(maze, glb_legacy, legacy_primitives, legacy_triangles);
+		double t_legacy = elapsed_ms(t0);
+
+		std::vector<unsigned char> glb;
+		t0 = Clock::now();
+		MazeModel model(size, size);
+		model.add_maze(maze);
+		model.save(glb);
+		double t_merged = elapsed_ms(t0);
+
+		// one prototype per piece, the glb is then mostly translations
+		MeshOptions instanced;
+		instanced.instanced = true;
+		std::vector<unsigned char> glb_instanced;
+		MazeModel instanced_model(size, size, instanced);
+		instanced_model.add_maze(maze);
+		instanced_model.save(glb_instanced);
+
+		// merged, with 16 and 8 bit attributes and indices
+		MeshOptions quantized;
+		quantized.quantized = true;
+		std::vector<unsigned char> glb_quantized;
+		MazeModel quantized_model(size, size, quantized);
+		quantized_model.add_maze(maze);
+		quantized_model.save(glb_quantized);
+
+		printf("%8d %12.3f %12.3f %7.2fx %12d %12d %12d %12d %10d %10d %12d %12d\n", size, t_legacy, t_merged, t_legacy / t_merged,
+			(int)legacy_primitives, (int)model.model().meshes[0].primitives.size(),
+			(int)legacy_triangles, (int)count_triangles(model.model()),
+			(int)(glb_legacy.size() / 1024), (int)(glb.size() / 1024), (int)(glb_instanced.size() / 1024),
+			(int)(glb_quantized.size() / 1024));
+	}
+}
+
+// Allocations while building a mesh, up to the glb being written: the legacy mesher,
+// rows added one by one, which grow the mesh, and a whole maze, counted up front.
+static void bench_mesh_allocations()
+{
+	printf("mesh allocations: building the mesh of a maze, before writing the glb\n");
+	printf("%8s %12s %12s %12s %12s %12s %12s\n", "size", "legacy", "legacy(ms)", "rows", "rows(ms)", "counted", "counted(ms)");
+
+	const int sizes[] = { 21, 101, 301 };
+	for (int size : sizes)
+	{
+		Maze maze(size, size, Random::random_seed());
+
+		size_t allocations = s_allocations;
+		Clock::time_point t0 = Clock::now();
+		{
+			tinygltf::Model legacy;
+			mesh_legacy_model(maze, legacy);
+		}
+		double t_legacy = elapsed_ms(t0);
+		size_t legacy_allocations = s_allocations - allocations;
+
+		allocations = s_allocations;
+		t0 = Clock::now();
+		{
+			MazeModel model(size, size);
+			std::vector<bool> x_walls(size - 1);
+			std::vector<bool> y_walls(size);
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					if (x < size - 1) x_walls[x] = maze.has_x_wall(x, y);
+					if (y < size - 1) y_walls[x] = maze.has_y_wall(x, y);
+				}
+				model.add_row(y, x_walls, y_walls);
+			}
+			model.model();
+		}
+		double t_rows = elapsed_ms(t0);
+		size_t row_allocations = s_allocations - allocations;
+
+		allocations = s_allocations;
+		t0 = Clock::now();
+		{
+			MazeModel model(size, size);
+			model.add_maze(maze);
+			model.model();
+		}
+		double t_counted = elapsed_ms(t0);
+		size_t counted_allocations = s_allocations - allocations;
+
+		printf("%8d %12d %12.3f %12d %12.3f %12d %12.3f\n", size, (int)legacy_allocations, t_legacy,
+			(int)row_allocations, t_rows, (int)counted_allocations, t_counted);
+	}
+}
+
+// The piece generators alone, into a Geometry that is cleared and reused
+static void bench_emit()
+{
+	printf("emit: vertices written per second by the piece generators\n");
+	printf("%14s %10s %12s %14s\n", "piece", "vertices", "time(ms)", "Mvertices/s");
+
+	const int repeats = 200000;
+	Geometry geo;
+	for (int piece = 0; piece < 4; piece++)
+	{
+		static const char* names[4] = { "ground", "pillar", "wall_x run", "wall_z run" };
+		size_t vertices = 0;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < repeats; i++)
+		{
+			if ((i & 255) == 0)
+			{
+				vertices += geo.positions.size();
+				geo.faces.clear();
+				geo.positions.clear();
+				geo.normals.clear();
+				geo.texcoords.clear();
+			}
+			int offset = i & 1023;
+			switch (piece)
+			{
+			case 0: geo.generate_ground(48, 48, offset, 0, offset); break;
+			case 1: geo.generate_pillar(8, 26, 8, offset, 0, offset, Geometry::FACE_ALL & ~Geometry::FACE_NEG_Y); break;
+			case 2: geo.generate_wall_x(6, 24, 144, offset, 0, offset, Geometry::FACE_NEG_X | Geometry::FACE_POS_X | Geometry::FACE_POS_Y); break;
+			case 3: geo.generate_wall_z(144, 24, 6, offset, 0, offset, Geometry::FACE_POS_Y | Geometry::FACE_NEG_Z | Geometry::FACE_POS_Z); break;
+			}
+		}
+		vertices += geo.positions.size();
+		double t = elapsed_ms(t0);
+		printf("%14s %10d %12.3f %14.1f\n", names[piece], (int)vertices, t, vertices / t / 1000.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	srand(time(nullptr));
+
+	const char* which = argc > 1 ? argv[1] : "all";
+	bool all = strcmp(which, "all") == 0;
+
+	if (all || strcmp(which, "generate") == 0) bench_generate();
+	if (all || strcmp(which, "algorithms") == 0) bench_algorithms();
+	if (all || strcmp(which, "tiled") == 0) bench_tiled();
+	if (all || strcmp(which, "batch") == 0) bench_batch();
+	if (all || strcmp(which, "analyze") == 0) bench_analyze();
+	if (all || strcmp(which, "bitboard") == 0) bench_bitboard();
+	if (all || strcmp(which, "fixed") == 0) bench_fixed();
+	if (all || strcmp(which, "difficulty") == 0) bench_difficulty();
+	if (all || strcmp(which, "index") == 0) bench_index();
+	if (all || strcmp(which, "metrics") == 0) bench_metrics();
+	if (all || strcmp(which, "solve") == 0) bench_solve();
+	if (all || strcmp(which, "mesh") == 0)
+	{
+		bench_mesh();
+		bench_mesh_allocations();
+	}
+	if (all || strcmp(which, "emit") == 0) bench_emit();
+
+	return 0;
+}
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include "bitboard_bfs.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BITBOARD_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define BITBOARD_AVX2 1
+#define AVX2_TARGET
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline int lowest_bit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+BitboardBFS::BitboardBFS()
+{
+	m_use_avx2 = cpu_has_avx2();
+}
+
+bool BitboardBFS::cpu_has_avx2()
+{
+#if defined(BITBOARD_AVX2) && defined(_MSC_VER)
+	return true;
+#elif defined(BITBOARD_AVX2)
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+
+// open east and south sides of the 2 cells packed in a byte of Maze::packed_row:
+// east bits in bits 0-1, south bits in bits 2-3
+struct PackedByteTable
+{
+	uint8_t walls[256];
+
+	PackedByteTable()
+	{
+		for (int b = 0; b < 256; b++)
+		{
+			int east = ((b >> 1) & 1) | (((b >> 5) & 1) << 1);
+			int south = ((b >> 3) & 1) | (((b >> 7) & 1) << 1);
+			walls[b] = (uint8_t)(east | (south << 2));
+		}
+	}
+};
+
+void BitboardBFS::load_walls(const Maze& maze)
+{
+	static const PackedByteTable table;
+
+	m_width = maze.m_width;
+	m_height = maze.m_height;
+	m_words = (m_width + 63) / 64;
+	m_stride = m_words + 2;
+
+	size_t size = (size_t)(m_height + 2) * m_stride;
+	m_east.assign(size, 0);
+	m_south.assign(size, 0);
+	m_visited.assign(size, 0);
+	m_frontier.assign(size, 0);
+	m_next.assign(size, 0);
+	m_row_slot.assign(m_height, -1);
+
+	int packed_words = (m_width + Maze::CELLS_PER_WORD - 1) / Maze::CELLS_PER_WORD;
+	for (int y = 0; y < m_height; y++)
+	{
+		const uint64_t* packed = maze.packed_row(y);
+		uint64_t* east = row(m_east, y);
+		uint64_t* south = row(m_south, y);
+		for (int p = 0; p < packed_words; p++)
+		{
+			uint64_t cells = packed[p];
+			uint64_t east16 = 0;
+			uint64_t south16 = 0;
+			for (int b = 0; b < 8; b++)
+			{
+				unsigned walls = table.walls[(cells >> (b * 8)) & 0xFF];
+				east16 |= (uint64_t)(walls & 3) << (b * 2);
+				south16 |= (uint64_t)(walls >> 2) << (b * 2);
+			}
+			east[p >> 2] |= east16 << ((p & 3) * 16);
+			south[p >> 2] |= south16 << ((p & 3) * 16);
+		}
+	}
+}
+
+void BitboardBFS::add_candidate(int y, int first, int last)
+{
+	if (y < 0 || y >= m_height) return;
+	if (first < 0) first = 0;
+	if (last > m_words - 1) last = m_words - 1;
+
+	int slot = m_row_slot[y];
+	if (slot < 0)
+	{
+		m_row_slot[y] = (int)m_rows.size();
+		m_rows.push_back({ y, first, last });
+		return;
+	}
+	RowRange& range = m_rows[slot];
+	if (first < range.first) range.first = first;
+	if (last > range.last) range.last = last;
+}
+
+void BitboardBFS::record(uint64_t bits, int y, int word, uint32_t step, std::vector<uint32_t>& steps)
+{
+	// extend the range of the row's next frontier, rows are expanded one at a time
+	if (m_next_active.empty() || m_next_active.back().row != y)
+	{
+		m_next_active.push_back({ y, word, word });
+	}
+	else
+	{
+		m_next_active.back().last = word;
+	}
+
+	uint32_t* row_steps = steps.data() + (size_t)y * m_width + (size_t)word * 64;
+	while (bits != 0)
+	{
+		row_steps[lowest_bit(bits)] = step;
+		bits &= bits - 1;
+	}
+}
+
+// cells of row y reachable in one move from the frontier: along the row through
+// open east walls of the cell on the left or right, and across from the rows
+// above and below through open south walls
+#define EXPAND_WORD(i) \
+	((((f[i] & e[i]) << 1) | ((f[(i) - 1] & e[(i) - 1]) >> 63) \
+	| (((f[i] >> 1) | (f[(i) + 1] << 63)) & e[i]) \
+	| (up[i] & s_up[i]) | (down[i] & s[i])) & ~v[i])
+
+#define ROW_POINTERS(y) \
+	const uint64_t* f = row(m_frontier, y); \
+	const uint64_t* up = row(m_frontier, (y) - 1); \
+	const uint64_t* down = row(m_frontier, (y) + 1); \
+	const uint64_t* e = row(m_east, y); \
+	const uint64_t* s = row(m_south, y); \
+	const uint64_t* s_up = row(m_south, (y) - 1); \
+	uint64_t* v = row(m_visited, y); \
+	uint64_t* n = row(m_next, y)
+
+void BitboardBFS::expand_row(const RowRange& range, uint32_t step, std::vector<uint32_t>& steps)
+{
+	ROW_POINTERS(range.row);
+
+	for (int i = range.first; i <= range.last; i++)
+	{
+		uint64_t bits = EXPAND_WORD(i);
+		if (bits == 0) continue;
+		v[i] |= bits;
+		n[i] = bits;
+		record(bits, range.row, i, step, steps);
+	}
+}
+
+#ifdef BITBOARD_AVX2
+AVX2_TARGET
+void BitboardBFS::expand_row_avx2(const RowRange& range, uint32_t step, std::vector<uint32_t>& steps)
+{
+	ROW_POINTERS(range.row);
+
+	int i = range.first;
+	for (; i + 3 <= range.last; i += 4)
+	{
+		__m256i f0 = _mm256_loadu_si256((const __m256i*)(f + i));
+		__m256i f_left = _mm256_loadu_si256((const __m256i*)(f + i - 1));
+		__m256i f_right = _mm256_loadu_si256((const __m256i*)(f + i + 1));
+		__m256i e0 = _mm256_loadu_si256((const __m256i*)(e + i));
+		__m256i e_left = _mm256_loadu_si256((const __m256i*)(e + i - 1));
+
+		__m256i east = _mm256_or_si256(
+			_mm256_slli_epi64(_mm256_and_si256(f0, e0), 1),
+			_mm256_srli_epi64(_mm256_and_si256(f_left, e_left), 63));
+		__m256i west = _mm256_and_si256(
+			_mm256_or_si256(_mm256_srli_epi64(f0, 1), _mm256_slli_epi64(f_right, 63)), e0);
+		__m256i vertical = _mm256_or_si256(
+			_mm256_and_si256(_mm256_loadu_si256((const __m256i*)(up + i)), _mm256_loadu_si256((const __m256i*)(s_up + i))),
+			_mm256_and_si256(_mm256_loadu_si256((const __m256i*)(down + i)), _mm256_loadu_si256((const __m256i*)(s + i))));
+
+		__m256i visited = _mm256_loadu_si256((const __m256i*)(v + i));
+		__m256i bits = _mm256_andnot_si256(visited, _mm256_or_si256(_mm256_or_si256(east, west), vertical));
+		if (_mm256_testz_si256(bits, bits)) continue;
+
+		_mm256_storeu_si256((__m256i*)(v + i), _mm256_or_si256(visited, bits));
+		_mm256_storeu_si256((__m256i*)(n + i), bits);
+		for (int j = i; j < i + 4; j++)
+		{
+			if (n[j] != 0) record(n[j], range.row, j, step, steps);
+		}
+	}
+	for (; i <= range.last; i++)
+	{
+		uint64_t bits = EXPAND_WORD(i);
+		if (bits == 0) continue;
+		v[i] |= bits;
+		n[i] = bits;
+		record(bits, range.row, i, step, steps);
+	}
+}
+#else
+void BitboardBFS::expand_row_avx2(const RowRange& range, uint32_t step, std::vector<uint32_t>& steps)
+{
+	expand_row(range, step, steps);
+}
+#endif
+
+uint32_t BitboardBFS::run(const Maze& maze, Maze::CellLocation goal, std::vector<uint32_t>& steps)
+{
+	load_walls(maze);
+	steps.assign((size_t)m_width * m_height, Maze::UNREACHED);
+
+	int word = goal.x >> 6;
+	uint64_t bit = 1ull << (goal.x & 63);
+	row(m_visited, goal.y)[word] = bit;
+	row(m_frontier, goal.y)[word] = bit;
+	steps[goal.x + (size_t)goal.y * m_width] = 0;
+
+	m_active.clear();
+	m_active.push_back({ goal.y, word, word });
+
+	uint32_t step = 0;
+	while (!m_active.empty())
+	{
+		step++;
+
+		// rows next to a frontier row, one word wider on each side for the horizontal moves
+		m_rows.clear();
+		for (const RowRange& range : m_active)
+		{
+			add_candidate(range.row - 1, range.first, range.last);
+			add_candidate(range.row, range.first - 1, range.last + 1);
+			add_candidate(range.row + 1, range.first, range.last);
+		}
+
+		m_next_active.clear();
+		for (const RowRange& range : m_rows)
+		{
+			m_row_slot[range.row] = -1;
+			if (m_use_avx2) expand_row_avx2(range, step, steps);
+			else expand_row(range, step, steps);
+		}
+
+		// the old frontier is cleared so it can take the frontier after next
+		for (const RowRange& range : m_active)
+		{
+			uint64_t* f = row(m_frontier, range.row);
+			std::fill(f + range.first, f + range.last + 1, 0);
+		}
+		m_frontier.swap(m_next);
+		m_active.swap(m_next_active);
+	}
+
+	m_max_steps = step - 1;
+	return m_max_steps;
+}
+
+void BitboardBFS::order_layer(const Maze& maze, const std::vector<uint32_t>& steps, std::vector<uint32_t>& cells) const
+{
+	// The queue based BFS lists the cells of a layer in the order of their parents,
+	// then by the direction leading to them. Each cell has a single parent in a
+	// perfect maze, so the layer can be ordered by walking up the tree until all
+	// its ancestors meet, then ranking back down.
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+	int w = maze.m_width;
+
+	// parent of a cell and the direction from the parent to it
+	auto parent = [&](uint32_t cell, int& dir_from_parent) -> uint32_t
+	{
+		int x = (int)(cell % w);
+		int y = (int)(cell / w);
+		unsigned dirs = maze.open_dirs(x, y);
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if ((dirs & (1u << dir)) == 0) continue;
+			uint32_t next = (uint32_t)(x + dx[dir] + (y + dy[dir]) * w);
+			if (steps[next] + 1 == steps[cell])
+			{
+				dir_from_parent = dir ^ 1;
+				return next;
+			}
+		}
+		dir_from_parent = 0;
+		return cell;
+	};
+
+	std::vector<std::vector<uint32_t>> levels(1, cells);
+	std::sort(levels[0].begin(), levels[0].end());
+	while (levels.back().size() > 1)
+	{
+		std::vector<uint32_t> parents;
+		parents.reserve(levels.back().size());
+		for (uint32_t cell : levels.back())
+		{
+			int dir;
+			parents.push_back(parent(cell, dir));
+		}
+		std::sort(parents.begin(), parents.end());
+		parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+		levels.push_back(std::move(parents));
+	}
+
+	std::vector<uint32_t> ranks(1, 0);
+	for (size_t level = levels.size() - 1; level-- > 0;)
+	{
+		const std::vector<uint32_t>& above = levels[level + 1];
+		const std::vector<uint32_t>& layer = levels[level];
+
+		std::vector<uint64_t> keys(layer.size());
+		for (size_t i = 0; i < layer.size(); i++)
+		{
+			int dir;
+			uint32_t p = parent(layer[i], dir);
+			size_t p_index = std::lower_bound(above.begin(), above.end(), p) - above.begin();
+			keys[i] = ((uint64_t)ranks[p_index] << 34) | ((uint64_t)dir << 32) | i;
+		}
+		std::sort(keys.begin(), keys.end());
+
+		std::vector<uint32_t> layer_ranks(layer.size());
+		for (size_t r = 0; r < keys.size(); r++)
+		{
+			layer_ranks[(uint32_t)keys[r]] = (uint32_t)r;
+		}
+		ranks.swap(layer_ranks);
+	}
+
+	cells.resize(levels[0].size());
+	for (size_t i = 0; i < levels[0].size(); i++)
+	{
+		cells[ranks[i]] = levels[0][i];
+	}
+}
+
+void BitboardBFS::farthest(const Maze& maze, const std::vector<uint32_t>& steps, int k, std::vector<Maze::CellLocation>& farthests)
+{
+	farthests.clear();
+	if (k <= 0) return;
+
+	// every layer holds at least one cell, so the k farthest come from the last k layers
+	uint32_t num_layers = (uint32_t)k < m_max_steps + 1 ? (uint32_t)k : m_max_steps + 1;
+	std::vector<std::vector<uint32_t>> layers(num_layers);
+	for (size_t cell = 0; cell < steps.size(); cell++)
+	{
+		uint32_t s = steps[cell];
+		if (s == Maze::UNREACHED || s + num_layers <= m_max_steps) continue;
+		layers[m_max_steps - s].push_back((uint32_t)cell);
+	}
+
+	for (std::vector<uint32_t>& layer : layers)
+	{
+		order_layer(maze, steps, layer);
+		for (size_t i = 0; i < layer.size() && farthests.size() < (size_t)k; i++)
+		{
+			farthests.push_back({ (int)(layer[i] % maze.m_width), (int)(layer[i] / maze.m_width) });
+		}
+		if (farthests.size() == (size_t)k) break;
+	}
+}
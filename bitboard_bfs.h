@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+
+// Breadth-first search over bit rows. The frontier, the visited set and the
+// open walls are kept one bit per cell, and a step expands the frontier a word
+// of 64 cells at a time with shifts and masks, 256 cells per AVX2 operation
+// when the CPU has it. Only the word ranges next to the frontier are swept.
+class BitboardBFS
+{
+public:
+	BitboardBFS();
+
+	// Fills steps with the distance of every cell to goal (Maze::UNREACHED if
+	// not connected) and returns the largest distance.
+	uint32_t run(const Maze& maze, Maze::CellLocation goal, std::vector<uint32_t>& steps);
+
+	// The k cells farthest from the goal of the last run, in the order the
+	// queue based BFS of Maze::analyze lists them. The maze must be perfect.
+	void farthest(const Maze& maze, const std::vector<uint32_t>& steps, int k, std::vector<Maze::CellLocation>& farthests);
+
+	// false forces the portable path, for comparisons
+	void set_use_avx2(bool use) { m_use_avx2 = use && cpu_has_avx2(); }
+
+	static bool cpu_has_avx2();
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	int m_words = 0;
+
+	// each bit row has a zero word on both ends, and there is a zero row above and below
+	int m_stride = 0;
+
+	std::vector<uint64_t> m_east;
+	std::vector<uint64_t> m_south;
+	std::vector<uint64_t> m_visited;
+	std::vector<uint64_t> m_frontier;
+	std::vector<uint64_t> m_next;
+
+	// rows holding frontier bits and the word range they span, for this step and the next
+	struct RowRange
+	{
+		int row;
+		int first;
+		int last;
+	};
+	std::vector<RowRange> m_active;
+	std::vector<RowRange> m_next_active;
+
+	// rows that can receive frontier bits this step
+	std::vector<RowRange> m_rows;
+	std::vector<int> m_row_slot;
+
+	uint32_t m_max_steps = 0;
+	bool m_use_avx2;
+
+	uint64_t* row(std::vector<uint64_t>& bits, int y) { return bits.data() + (size_t)(y + 1) * m_stride + 1; }
+
+	void load_walls(const Maze& maze);
+	void add_candidate(int y, int first, int last);
+
+	// compute the next frontier over a row range, recording the distance of the cells reached
+	void expand_row(const RowRange& range, uint32_t step, std::vector<uint32_t>& steps);
+	void expand_row_avx2(const RowRange& range, uint32_t step, std::vector<uint32_t>& steps);
+
+	void record(uint64_t bits, int y, int word, uint32_t step, std::vector<uint32_t>& steps);
+	void order_layer(const Maze& maze, const std::vector<uint32_t>& steps, std::vector<uint32_t>& cells) const;
+};
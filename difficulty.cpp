@@ -0,0 +1,217 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "difficulty.h"
+#include "thread_pool.h"
+
+static int count_open(unsigned dirs)
+{
+	return (int)(dirs & 1) + (int)((dirs >> 1) & 1) + (int)((dirs >> 2) & 1) + (int)((dirs >> 3) & 1);
+}
+
+// BFS from the goal over the open walls, returning the largest distance reached
+static int farthest_distance(const Maze& maze, int goal, std::vector<int>& steps, std::vector<int>& queue)
+{
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+
+	int w = maze.m_width;
+	int h = maze.m_height;
+	steps.assign(w * h, -1);
+	queue.resize(w * h);
+
+	steps[goal] = 0;
+	queue[0] = goal;
+	int head = 0;
+	int tail = 1;
+	int farthest = 0;
+	while (head < tail)
+	{
+		int cell = queue[head++];
+		int x = cell % w;
+		int y = cell / w;
+		farthest = steps[cell];
+
+		unsigned dirs = maze.open_dirs(x, y);
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if ((dirs & (1u << dir)) == 0) continue;
+			int next = x + dx[dir] + (y + dy[dir]) * w;
+			if (steps[next] >= 0) continue;
+			steps[next] = steps[cell] + 1;
+			queue[tail++] = next;
+		}
+	}
+	return farthest;
+}
+
+// length of the straight run through (x, y) along the axis of dir
+static int corridor_through(const Maze& maze, int x, int y, int dir)
+{
+	int length = 1;
+	if (dir == Maze::DIR_NEG_X || dir == Maze::DIR_POS_X)
+	{
+		for (int i = x; i > 0 && maze.is_open(i, y, Maze::DIR_NEG_X); i--) length++;
+		for (int i = x; i < maze.m_width - 1 && maze.is_open(i, y, Maze::DIR_POS_X); i++) length++;
+	}
+	else
+	{
+		for (int i = y; i > 0 && maze.is_open(x, i, Maze::DIR_NEG_Y); i--) length++;
+		for (int i = y; i < maze.m_height - 1 && maze.is_open(x, i, Maze::DIR_POS_Y); i++) length++;
+	}
+	return length;
+}
+
+// Keeps bounds on the final metrics while a candidate is carved. Openings are
+// never closed again, so:
+//  - a cell with 2 or more open sides never becomes a dead end, bounding dead ends from above
+//  - a tree with sum(degree - 2) over its branching cells has at least 2 + that many leaves
+//  - corridors only get longer, and so do distances to the goal within its connected part
+// That last one holds for a single goal only: joining a part with another goal
+// can bring cells nearer, so with several goals the solution length is not bounded.
+class DifficultyMonitor : public CarveObserver
+{
+public:
+	DifficultyMonitor(const DifficultyTarget& target, int width, int height, const std::vector<Maze::CellLocation>& goals,
+		const std::atomic<int>& best, int index)
+		: m_target(target)
+		, m_best(best)
+		, m_index(index)
+		, m_num_cells(width * height)
+		, m_check_interval(width * height / 16 > 0 ? width * height / 16 : 1)
+		, m_goal(goals.empty() ? width * height - 1 : goals.size() == 1 ? goals[0].x + goals[0].y * width : -1)
+	{
+	}
+
+	bool abandoned() const { return m_abandoned; }
+
+	bool carved(const Maze& maze, int x, int y, int dir) override
+	{
+		static const int dx[4] = { -1, 1, 0, 0 };
+		static const int dy[4] = { 0, 0, -1, 1 };
+
+		// a lower numbered candidate already qualified
+		if (m_index > m_best.load(std::memory_order_relaxed)) return abandon();
+
+		add_degree(count_open(maze.open_dirs(x, y)));
+		add_degree(count_open(maze.open_dirs(x + dx[dir], y + dy[dir])));
+		if (m_num_cells > 1)
+		{
+			if (m_num_cells - m_inner < m_target.dead_ends.min) return abandon();
+			if (2 + m_excess > m_target.dead_ends.max) return abandon();
+		}
+
+		if (m_target.longest_corridor.max < INT_MAX)
+		{
+			if (corridor_through(maze, x, y, dir) > m_target.longest_corridor.max) return abandon();
+		}
+
+		if (m_goal >= 0 && m_target.solution_length.max < INT_MAX && ++m_carved % m_check_interval == 0)
+		{
+			if (farthest_distance(maze, m_goal, m_steps, m_queue) > m_target.solution_length.max) return abandon();
+		}
+		return true;
+	}
+
+private:
+	const DifficultyTarget& m_target;
+	const std::atomic<int>& m_best;
+	int m_index;
+	int m_num_cells;
+	int m_check_interval;
+
+	// the single goal, -1 with several
+	int m_goal;
+
+	bool m_abandoned = false;
+	int m_carved = 0;
+
+	// cells with at least 2 open sides, and sum(open sides - 2) over cells with more
+	int m_inner = 0;
+	int m_excess = 0;
+
+	std::vector<int> m_steps;
+	std::vector<int> m_queue;
+
+	void add_degree(int degree)
+	{
+		if (degree == 2) m_inner++;
+		if (degree >= 3) m_excess++;
+	}
+
+	bool abandon()
+	{
+		m_abandoned = true;
+		return false;
+	}
+};
+
+void find_maze(int width, int height, MazeAlgorithm algorithm, uint64_t seed, const DifficultyTarget& target,
+	const std::vector<Maze::CellLocation>& goals, ThreadPool* pool, DifficultySearch& search)
+{
+	int count = target.max_candidates > 1 ? target.max_candidates : 1;
+
+	std::vector<uint64_t> seeds(count);
+	seeds[0] = seed;
+	Random rng(seed);
+	for (int i = 1; i < count; i++)
+	{
+		seeds[i] = rng.next() & Random::max_seed;
+	}
+
+	std::atomic<int> best(INT_MAX);
+	std::atomic<int> candidates(0);
+	std::atomic<int> abandoned(0);
+	std::mutex mutex;
+
+	auto run = [&](int i)
+	{
+		if (i > best.load()) return;
+		candidates++;
+
+		std::unique_ptr<MazeGenerator> generator = MazeGenerator::create(algorithm);
+		DifficultyMonitor monitor(target, width, height, goals, best, i);
+		generator->set_observer(&monitor);
+
+		std::unique_ptr<Maze> maze(new Maze(width, height, seeds[i], *generator));
+		if (monitor.abandoned())
+		{
+			abandoned++;
+			return;
+		}
+
+		MazeMetrics metrics;
+		MetricsKernel kernel;
+		kernel.measure(*maze, metrics, goals);
+		if (!target.accepts(metrics)) return;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (i < best.load())
+		{
+			best = i;
+			search.maze = std::move(maze);
+			search.metrics = metrics;
+		}
+	};
+
+	if (pool != nullptr)
+	{
+		pool->parallel_for(count, run);
+	}
+	else
+	{
+		for (int i = 0; i < count && best.load() == INT_MAX; i++)
+		{
+			run(i);
+		}
+	}
+
+	search.candidates = candidates;
+	search.abandoned = abandoned;
+	search.met_target = search.maze != nullptr;
+	if (!search.met_target)
+	{
+		search.maze.reset(new Maze(width, height, seed, algorithm));
+		measure(*search.maze, search.metrics, goals);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "maze.h"
+#include "maze_metrics.h"
+
+class ThreadPool;
+
+struct MetricRange
+{
+	int min = 0;
+	int max = INT_MAX;
+
+	bool contains(int value) const { return value >= min && value <= max; }
+	bool bounded() const { return min > 0 || max < INT_MAX; }
+};
+
+struct DifficultyTarget
+{
+	MetricRange solution_length;
+	MetricRange dead_ends;
+	MetricRange longest_corridor;
+
+	// candidates to try before giving up
+	int max_candidates = 1000;
+
+	bool active() const { return solution_length.bounded() || dead_ends.bounded() || longest_corridor.bounded(); }
+
+	bool accepts(const MazeMetrics& metrics) const
+	{
+		return solution_length.contains(metrics.solution_length)
+			&& dead_ends.contains(metrics.dead_ends)
+			&& longest_corridor.contains(metrics.longest_corridor);
+	}
+};
+
+struct DifficultySearch
+{
+	std::unique_ptr<Maze> maze;
+	MazeMetrics metrics;
+
+	// false if no candidate met the target, maze is then the first candidate
+	bool met_target = false;
+
+	// candidates started and candidates dropped before they were fully carved
+	int candidates = 0;
+	int abandoned = 0;
+};
+
+// Generates candidate mazes on the pool until one meets the target. Candidate 0
+// uses seed itself, the others seeds drawn from it; a candidate is abandoned as
+// soon as the walls carved so far rule it out. The accepted maze is the lowest
+// numbered candidate that qualifies, so the result does not depend on the number
+// of threads, and it can be regenerated from its own seed.
+// Metrics are measured to the nearest of goals, the bottom right corner if empty.
+void find_maze(int width, int height, MazeAlgorithm algorithm, uint64_t seed, const DifficultyTarget& target,
+	const std::vector<Maze::CellLocation>& goals, ThreadPool* pool, DifficultySearch& search);
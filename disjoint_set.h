@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Disjoint-set forest with path compression and union by rank
+class DisjointSet
+{
+public:
+	DisjointSet(int count) : m_parent(count), m_rank(count, 0)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			m_parent[i] = i;
+		}
+	}
+
+	int find(int i)
+	{
+		int root = i;
+		while (m_parent[root] != root)
+		{
+			root = m_parent[root];
+		}
+
+		while (m_parent[i] != root)
+		{
+			int next = m_parent[i];
+			m_parent[i] = root;
+			i = next;
+		}
+		return root;
+	}
+
+	// returns false if i and j were already in the same set
+	bool unite(int i, int j)
+	{
+		int root_i = find(i);
+		int root_j = find(j);
+		if (root_i == root_j) return false;
+
+		if (m_rank[root_i] < m_rank[root_j])
+		{
+			m_parent[root_i] = root_j;
+		}
+		else if (m_rank[root_i] > m_rank[root_j])
+		{
+			m_parent[root_j] = root_i;
+		}
+		else
+		{
+			m_parent[root_j] = root_i;
+			m_rank[root_i]++;
+		}
+		return true;
+	}
+
+private:
+	std::vector<int> m_parent;
+	std::vector<uint8_t> m_rank;
+};
@@ -1,282 +1,534 @@
 #include <napi.h>
 
-#include <ctime>
-#include <cstdlib>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 #include <string>
-#include <glm.hpp>
-
-#define TINYGLTF_NO_STB_IMAGE
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#include <tiny_gltf.h>
 
 #include "maze.h"
-#include "geometry.h"
-
-
-Napi::Array CreateAMaze(const Napi::CallbackInfo& info) {
-
-	std::string filename = info[0].As<Napi::String>().Utf8Value();
-	std::string model_path = std::string("client/scene/assets/models/") + filename;
+#include "batch.h"
+#include "maze_pool.h"
+#include "maze_index.h"
+#include "thread_pool.h"
 
-	int maze_w = info[1].As<Napi::Number>().Int32Value();
-	int maze_h = info[2].As<Napi::Number>().Int32Value();
+static const char* s_model_dir = "client/scene/assets/models/";
 
-	Maze maze(maze_w, maze_h);	
+// mazes built ahead for createAMaze, set up by configurePool
+static std::unique_ptr<MazePool> s_pool;
 
-	tinygltf::Model m_out;
-	m_out.scenes.resize(1);
-	tinygltf::Scene& scene_out = m_out.scenes[0];
-	scene_out.name = "Scene";
-
-	m_out.asset.version = "2.0";
-	m_out.asset.generator = "tinygltf";
-
-	m_out.buffers.resize(1);
-	tinygltf::Buffer& buf_out = m_out.buffers[0];
-
-	size_t offset = 0;
-	size_t length = 0;
-	size_t view_id = 0;
-	size_t acc_id = 0;
-
-	// sampler
-	m_out.samplers.resize(1);
-	tinygltf::Sampler& sampler = m_out.samplers[0];
-	sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
-	sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+// Reads the optional options object shared by createAMaze and createManyMazes.
+// Returns false with a pending JavaScript exception on bad input.
+static bool ParseOptions(Napi::Env env, const Napi::Value& value, MazeRequest& request, bool& has_seed)
+{
+	has_seed = false;
+	if (!value.IsObject()) return true;
 
-	// texture
-	struct TexInfo
+	Napi::Object options = value.As<Napi::Object>();
+	if (options.Has("algorithm"))
 	{
-		std::string path;
-		int width;
-		int height;
-	};
-
-	TexInfo tex_info[3] = {
+		std::string name = options.Get("algorithm").As<Napi::String>().Utf8Value();
+		if (!parse_algorithm(name.c_str(), request.algorithm))
 		{
-			"textures/ground.jpg",
-			1024, 1024
-		},
+			Napi::TypeError::New(env, "Unknown maze algorithm: " + name).ThrowAsJavaScriptException();
+			return false;
+		}
+	}
+	if (options.Has("seed"))
+	{
+		double seed = options.Get("seed").As<Napi::Number>().DoubleValue();
+		if (!(seed >= 0.0 && seed <= (double)Random::max_seed) || seed != (double)(uint64_t)seed)
 		{
-			"textures/pillar.jpg",
-			964, 1024
-		},
+			Napi::RangeError::New(env, "Maze seed must be an integer in [0, 2^53)").ThrowAsJavaScriptException();
+			return false;
+		}
+		request.seed = (uint64_t)seed;
+		has_seed = true;
+	}
+	if (options.Has("tile_size"))
+	{
+		request.tile_size = options.Get("tile_size").As<Napi::Number>().Int32Value();
+	}
+	if (options.Has("distances"))
+	{
+		request.distances = options.Get("distances").ToBoolean().Value();
+	}
+	if (options.Has("fair_starts"))
+	{
+		request.fair_starts = options.Get("fair_starts").ToBoolean().Value();
+	}
+	if (options.Has("lone_pillars"))
+	{
+		request.mesh.lone_pillars = options.Get("lone_pillars").ToBoolean().Value();
+	}
+	if (options.Has("instanced"))
+	{
+		request.mesh.instanced = options.Get("instanced").ToBoolean().Value();
+	}
+	if (options.Has("quantized"))
+	{
+		request.mesh.quantized = options.Get("quantized").ToBoolean().Value();
+	}
+	if (options.Has("goals"))
+	{
+		// [{x, y}, ...], inside the maze
+		Napi::Array goals = options.Get("goals").As<Napi::Array>();
+		request.goals.resize(goals.Length());
+		for (uint32_t i = 0; i < goals.Length(); i++)
 		{
-			"textures/wall.jpg",
-			922, 1024
-		},
-	};
+			Napi::Object goal = goals.Get(i).As<Napi::Object>();
+			Maze::CellLocation& loc = request.goals[i];
+			loc.x = goal.Get("x").ToNumber().Int32Value();
+			loc.y = goal.Get("y").ToNumber().Int32Value();
+			if (loc.x < 0 || loc.x >= request.width || loc.y < 0 || loc.y >= request.height)
+			{
+				Napi::RangeError::New(env, "Goal outside the maze").ThrowAsJavaScriptException();
+				return false;
+			}
+		}
+	}
+	if (options.Has("difficulty"))
+	{
+		// {solution_length: {min, max}, dead_ends: {min, max}, longest_corridor: {min, max}, max_candidates}
+		Napi::Object difficulty = options.Get("difficulty").As<Napi::Object>();
+		auto parse_range = [&](const char* name, MetricRange& range)
+		{
+			if (!difficulty.Has(name)) return;
+			Napi::Object bounds = difficulty.Get(name).As<Napi::Object>();
+			if (bounds.Has("min")) range.min = bounds.Get("min").As<Napi::Number>().Int32Value();
+			if (bounds.Has("max")) range.max = bounds.Get("max").As<Napi::Number>().Int32Value();
+		};
+		parse_range("solution_length", request.difficulty.solution_length);
+		parse_range("dead_ends", request.difficulty.dead_ends);
+		parse_range("longest_corridor", request.difficulty.longest_corridor);
+		if (difficulty.Has("max_candidates"))
+		{
+			request.difficulty.max_candidates = difficulty.Get("max_candidates").As<Napi::Number>().Int32Value();
+		}
+	}
+	return true;
+}
+
+// Throws a RangeError and returns false unless the maze has at least 2 cells
+static bool CheckMazeSize(Napi::Env env, int width, int height)
+{
+	if (width < 1 || height < 1 || (int64_t)width * height < 2)
+	{
+		Napi::RangeError::New(env, "Maze must have at least 2 cells").ThrowAsJavaScriptException();
+		return false;
+	}
+	return true;
+}
 
-	m_out.images.resize(3);
-	m_out.textures.resize(3);
+// Wraps per cell values in a Uint32Array backed by the native buffer itself,
+// which is freed when the array is collected
+static Napi::Uint32Array CellsToArray(Napi::Env env, std::vector<uint32_t>&& values)
+{
+	std::vector<uint32_t>* buffer = new std::vector<uint32_t>(std::move(values));
+	size_t length = buffer->size();
+	Napi::ArrayBuffer array_buffer = Napi::ArrayBuffer::New(env, buffer->data(), length * sizeof(uint32_t),
+		[](Napi::Env, void*, std::vector<uint32_t>* buffer) { delete buffer; }, buffer);
+	return Napi::Uint32Array::New(env, length, array_buffer, 0);
+}
 
-	for (int i = 0; i < 3; i++)
+static Napi::Object MetricsToObject(Napi::Env env, const MazeMetrics& metrics)
+{
+	Napi::Array rivers = Napi::Array::New(env, metrics.river_buckets());
+	for (int i = 0; i < metrics.river_buckets(); i++)
 	{
-		TexInfo& info = tex_info[i];
-		tinygltf::Image& img_out = m_out.images[i];
-		tinygltf::Texture& tex_out = m_out.textures[i];
-		img_out.width = info.width;
-		img_out.height = info.height;
-		img_out.component = 4;
-		img_out.bits = 8;
-		img_out.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-		img_out.uri = info.path;
+		rivers.Set(i, Napi::Number::New(env, metrics.rivers[i]));
+	}
 
-		tex_out.sampler = 0;
-		tex_out.source = i;
+	Napi::Object ret = Napi::Object::New(env);
+	ret.Set("solution_length", Napi::Number::New(env, metrics.solution_length));
+	ret.Set("solution_cells", Napi::Number::New(env, metrics.solution_cells));
+	ret.Set("max_branch_depth", Napi::Number::New(env, metrics.max_branch_depth));
+	ret.Set("dead_ends", Napi::Number::New(env, metrics.dead_ends));
+	ret.Set("junctions", Napi::Number::New(env, metrics.junctions));
+	ret.Set("longest_corridor", Napi::Number::New(env, metrics.longest_corridor));
+	ret.Set("rivers", rivers);
+	return ret;
+}
+
+// met_target is only reported for requests with a difficulty target,
+// distances only for requests asking for them
+static Napi::Object ResultToObject(Napi::Env env, MazeResult& result, bool with_target)
+{
+	Napi::Array start_points = Napi::Array::New(env, result.start_points.size());
+	for (size_t i = 0; i < result.start_points.size(); i++)
+	{
+		Maze::CellLocation loc = result.start_points[i];
+		Napi::Object pos = Napi::Object::New(env);
+		pos.Set("x", Napi::Number::New(env, loc.x));
+		pos.Set("y", Napi::Number::New(env, loc.y));
+		start_points.Set(i, pos);
 	}
 
-	// material
-	m_out.materials.resize(3);
+	Napi::Object ret = Napi::Object::New(env);
+	ret.Set("seed", Napi::Number::New(env, (double)result.seed));
+	ret.Set("start_points", start_points);
+	ret.Set("metrics", MetricsToObject(env, result.metrics));
+	if (with_target)
 	{
-		tinygltf::Material& material_out = m_out.materials[0];
-		material_out.name = "ground";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 0;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.2;
-		material_out.pbrMetallicRoughness.roughnessFactor = 0.1;
+		ret.Set("met_target", Napi::Boolean::New(env, result.met_target));
 	}
+	if (!result.distances.empty())
 	{
-		tinygltf::Material& material_out = m_out.materials[1];
-		material_out.name = "pillar";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 1;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
-		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;
+		ret.Set("distances", CellsToArray(env, std::move(result.distances)));
 	}
+	if (!result.nearest_goals.empty())
 	{
-		tinygltf::Material& material_out = m_out.materials[2];
-		material_out.name = "wall";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 2;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
-		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;
+		ret.Set("nearest_goals", CellsToArray(env, std::move(result.nearest_goals)));
 	}
+	return ret;
+}
 
-	// node
-	m_out.nodes.resize(1);
-	tinygltf::Node& node_out = m_out.nodes[0];
-	scene_out.nodes.push_back(0);
+// createAMaze(filename, width, height, options) -> {seed, start_points, metrics}
+// metrics: solution_length, solution_cells, max_branch_depth, dead_ends, junctions,
+// longest_corridor, and rivers[i], the passages of [2^i, 2^(i+1)) cells between junctions
+// options: algorithm, seed, tile_size, difficulty, and distances: true to also get
+// a Uint32Array of every cell's (x + y * width) distance to the goal.
+// fair_starts: false gives the 6 farthest cells instead of 6 cells at one distance
+// from the goal spread apart.
+// goals: [{x, y}, ...] exits instead of the bottom right corner. Start points, distances,
+// metrics and difficulty are then to the nearest goal, and with distances comes nearest_goals,
+// a Uint32Array of each cell's nearest goal as an index in goals.
+// lone_pillars: false leaves out the pillars no wall touches.
+// instanced: true writes one prototype per piece placed by EXT_mesh_gpu_instancing,
+// which the bundled client loader does not read.
+// quantized: true writes 16 and 8 bit vertex attributes and indices, KHR_mesh_quantization.
+Napi::Value CreateAMaze(const Napi::CallbackInfo& info) {
 
-	// mesh
-	m_out.meshes.resize(1);
-	tinygltf::Mesh& mesh_out = m_out.meshes[0];
-	node_out.mesh = 0;
+	Napi::Env env = info.Env();
+
+	std::string filename = info[0].As<Napi::String>().Utf8Value();
 
-	// ground
-	int origin_x = -maze_w * 48 / 2;
-	int origin_y = -maze_h * 48 / 2;
-	for (int y = 0; y < maze_h; y++)
+	MazeRequest request;
+	request.path = s_model_dir + filename;
+	request.width = info[1].As<Napi::Number>().Int32Value();
+	request.height = info[2].As<Napi::Number>().Int32Value();
+	request.seed = Random::random_seed();
+	if (!CheckMazeSize(env, request.width, request.height)) return env.Undefined();
+
+	bool has_seed;
+	if (!ParseOptions(env, info[3], request, has_seed)) return env.Undefined();
+
+	MazeResult result;
+	PooledMaze pooled;
+	if (s_pool != nullptr && s_pool->matches(request, has_seed) && s_pool->claim(pooled))
 	{
-		for (int x = 0; x < maze_w; x++)
+		result.seed = pooled.seed;
+		result.start_points = std::move(pooled.start_points);
+		result.metrics = pooled.metrics;
+		if (request.distances)
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 0;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-			Geometry ground;
-			ground.generate_ground(48, 48, origin_x + x * 48, 0, origin_y + y * 48);
-			ground.to_gltf(m_out, prim_out);
-			mesh_out.primitives.emplace_back(prim_out);
+			result.distances = std::move(pooled.distances);
+			result.nearest_goals = std::move(pooled.nearest_goals);
 		}
+		result.saved = write_file(request.path, pooled.glb);
+	}
+	else
+	{
+		build_maze(request, &ThreadPool::shared(), result);
 	}
 
-	// pillars
-	for (int y = 0; y < maze_h + 1; y++)
+	return ResultToObject(env, result, request.difficulty.active());
+}
+
+// configurePool({size, width, height, algorithm, goals, lone_pillars, instanced, quantized, threads})
+// Keeps size mazes ready for createAMaze calls of the same shape; size 0 turns the pool off.
+// threads 0 counts as 1.
+Napi::Value ConfigurePool(const Napi::CallbackInfo& info) {
+
+	Napi::Env env = info.Env();
+
+	MazeRequest config;
+	int size = 0;
+	int threads = 1;
+
+	// the size first, goals are checked against it
+	if (info[0].IsObject())
 	{
-		for (int x = 0; x < maze_w + 1; x++)
-		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 1;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-			Geometry wall;
-			wall.generate_pillar(8, 26, 8, origin_x + x * 48 - 4, 0, origin_y + y * 48 - 4);
-			wall.to_gltf(m_out, prim_out);
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+		Napi::Object options = info[0].As<Napi::Object>();
+		if (options.Has("size")) size = options.Get("size").As<Napi::Number>().Int32Value();
+		if (options.Has("width")) config.width = options.Get("width").As<Napi::Number>().Int32Value();
+		if (options.Has("height")) config.height = options.Get("height").As<Napi::Number>().Int32Value();
+		if (options.Has("threads")) threads = options.Get("threads").As<Napi::Number>().Int32Value();
+	}
+	if (size < 0 || threads < 0)
+	{
+		Napi::RangeError::New(env, "Pool size and threads must not be negative").ThrowAsJavaScriptException();
+		return env.Undefined();
 	}
+	if (size > 0 && !CheckMazeSize(env, config.width, config.height)) return env.Undefined();
+
+	bool has_seed;
+	if (!ParseOptions(env, info[0], config, has_seed)) return env.Undefined();
 
-	// outer walls
-	for (int x = 0; x < maze_w; x++)
+	s_pool.reset();
+	if (size > 0)
 	{
-		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+		s_pool.reset(new MazePool(config, size, threads));
+	}
+	return env.Undefined();
+}
 
-			Geometry wall;
-			wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y - 3);
-			wall.to_gltf(m_out, prim_out);
+// getPoolStats() -> {capacity, ready, hits, misses, refills, last/avg/max_refill_ms}, or null without a pool
+Napi::Value GetPoolStats(const Napi::CallbackInfo& info) {
 
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+	Napi::Env env = info.Env();
+	if (s_pool == nullptr) return env.Null();
+
+	MazePoolStats stats = s_pool->stats();
+	Napi::Object ret = Napi::Object::New(env);
+	ret.Set("capacity", Napi::Number::New(env, stats.capacity));
+	ret.Set("ready", Napi::Number::New(env, stats.ready));
+	ret.Set("hits", Napi::Number::New(env, (double)stats.hits));
+	ret.Set("misses", Napi::Number::New(env, (double)stats.misses));
+	ret.Set("refills", Napi::Number::New(env, (double)stats.refills));
+	ret.Set("last_refill_ms", Napi::Number::New(env, stats.last_refill_ms));
+	ret.Set("avg_refill_ms", Napi::Number::New(env, stats.avg_refill_ms));
+	ret.Set("max_refill_ms", Napi::Number::New(env, stats.max_refill_ms));
+	return ret;
+}
 
-		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+// Builds a batch of mazes on the shared pool without blocking the event loop
+class CreateManyMazesWorker : public Napi::AsyncWorker
+{
+public:
+	CreateManyMazesWorker(Napi::Env env, std::vector<MazeRequest>&& requests, std::vector<std::string>&& files)
+		: Napi::AsyncWorker(env)
+		, m_deferred(Napi::Promise::Deferred::New(env))
+		, m_requests(std::move(requests))
+		, m_files(std::move(files))
+	{
+	}
 
-			Geometry wall;
-			wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y + maze_h * 48 - 3);
-			wall.to_gltf(m_out, prim_out);
+	Napi::Promise Promise() { return m_deferred.Promise(); }
 
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+	void Execute() override
+	{
+		build_mazes(m_requests, &ThreadPool::shared(), m_results);
 	}
 
-	for (int y = 0; y < maze_h; y++)
+	void OnOK() override
 	{
+		Napi::Env env = Env();
+		Napi::Array records = Napi::Array::New(env, m_results.size());
+		for (size_t i = 0; i < m_results.size(); i++)
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+			Napi::Object record = ResultToObject(env, m_results[i], m_requests[i].difficulty.active());
+			record.Set("file", m_results[i].saved ? Napi::Value(Napi::String::New(env, m_files[i])) : env.Null());
+			records.Set(i, record);
+		}
+		m_deferred.Resolve(records);
+	}
 
-			Geometry wall;
-			wall.generate_wall_x(6, 24, 48, origin_x - 3, 0, origin_y + y * 48);
-			wall.to_gltf(m_out, prim_out);
+	void OnError(const Napi::Error& error) override
+	{
+		m_deferred.Reject(error.Value());
+	}
 
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+private:
+	Napi::Promise::Deferred m_deferred;
+	std::vector<MazeRequest> m_requests;
+	std::vector<std::string> m_files;
+	std::vector<MazeResult> m_results;
+};
 
-		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+// createManyMazes(count, width, height, options) -> Promise of [{seed, start_points, metrics, file}]
+// Files are named <prefix><first_index + i>.glb, prefix defaulting to "maze_".
+Napi::Value CreateManyMazes(const Napi::CallbackInfo& info) {
 
-			Geometry wall;
-			wall.generate_wall_x(6, 24, 48, origin_x + maze_w * 48 - 3, 0, origin_y + y * 48);
-			wall.to_gltf(m_out, prim_out);
+	Napi::Env env = info.Env();
 
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+	int count = info[0].As<Napi::Number>().Int32Value();
+
+	MazeRequest base;
+	base.width = info[1].As<Napi::Number>().Int32Value();
+	base.height = info[2].As<Napi::Number>().Int32Value();
+	if (count < 0)
+	{
+		Napi::RangeError::New(env, "Maze count must not be negative").ThrowAsJavaScriptException();
+		return env.Undefined();
 	}
+	if (!CheckMazeSize(env, base.width, base.height)) return env.Undefined();
+
+	bool has_seed;
+	if (!ParseOptions(env, info[3], base, has_seed)) return env.Undefined();
 
-	// maze walls
-	for (int y = 0; y < maze_h; y++)
+	std::string prefix = "maze_";
+	int first_index = 0;
+	if (info[3].IsObject())
 	{
-		for (int x = 0; x < maze_w - 1; x++)
-		{
-			if (maze.x_walls[x + y * (maze_w - 1)])
-			{
-				tinygltf::Primitive prim_out;
-				prim_out.material = 2;
-				prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+		Napi::Object options = info[3].As<Napi::Object>();
+		if (options.Has("prefix")) prefix = options.Get("prefix").As<Napi::String>().Utf8Value();
+		if (options.Has("first_index")) first_index = options.Get("first_index").As<Napi::Number>().Int32Value();
+	}
 
-				Geometry wall;
-				wall.generate_wall_x(6, 24, 48, origin_x + (x + 1) * 48 - 3, 0, origin_y + y * 48);
-				wall.to_gltf(m_out, prim_out);
+	// a given seed makes the whole batch reproducible
+	Random seeds(has_seed ? base.seed : Random::random_seed());
 
-				mesh_out.primitives.emplace_back(prim_out);
-			}
-		}
+	std::vector<MazeRequest> requests(count, base);
+	std::vector<std::string> files(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		files[i] = prefix + std::to_string(first_index + (int)i) + ".glb";
+		requests[i].path = s_model_dir + files[i];
+		requests[i].seed = seeds.next() & Random::max_seed;
 	}
 
-	for (int y = 0; y < maze_h - 1; y++)
+	CreateManyMazesWorker* worker = new CreateManyMazesWorker(env, std::move(requests), std::move(files));
+	Napi::Promise promise = worker->Promise();
+	worker->Queue();
+	return promise;
+}
+
+// new MazeIndex(width, height, {seed, algorithm, tile_size, goals}) rebuilds the maze of
+// a createAMaze result from its seed and answers path queries on it:
+// distance(a, b), pathLengthVia(a, b, c) and nextStep(a, b), cells as {x, y}.
+// solve(a) -> {steps, moves}, the way from a to its nearest goal as a Uint8Array of
+// 2 bits per step (0: -x, 1: +x, 2: -y, 3: +y), first step in the low bits.
+class MazeIndexWrap : public Napi::ObjectWrap<MazeIndexWrap>
+{
+public:
+	static Napi::Function Define(Napi::Env env)
 	{
-		for (int x = 0; x < maze_w; x++)
-		{
-			if (maze.y_walls[x + y * maze_w])
-			{
-				tinygltf::Primitive prim_out;
-				prim_out.material = 2;
-				prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+		return DefineClass(env, "MazeIndex", {
+			InstanceMethod("distance", &MazeIndexWrap::Distance),
+			InstanceMethod("pathLengthVia", &MazeIndexWrap::PathLengthVia),
+			InstanceMethod("nextStep", &MazeIndexWrap::NextStep),
+			InstanceMethod("solve", &MazeIndexWrap::Solve),
+		});
+	}
 
-				Geometry wall;
-				wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y + (y + 1) * 48 - 3);
-				wall.to_gltf(m_out, prim_out);
+	MazeIndexWrap(const Napi::CallbackInfo& info) : Napi::ObjectWrap<MazeIndexWrap>(info)
+	{
+		Napi::Env env = info.Env();
 
-				mesh_out.primitives.emplace_back(prim_out);
-			}
+		MazeRequest request;
+		request.width = info[0].As<Napi::Number>().Int32Value();
+		request.height = info[1].As<Napi::Number>().Int32Value();
+
+		bool has_seed;
+		if (!ParseOptions(env, info[2], request, has_seed)) return;
+		if (!has_seed)
+		{
+			Napi::TypeError::New(env, "MazeIndex needs the seed of the maze").ThrowAsJavaScriptException();
+			return;
+		}
+		if (!CheckMazeSize(env, request.width, request.height)) return;
+
+		// the same maze build_maze makes for this seed
+		std::unique_ptr<MazeGenerator> generator;
+		if (request.tile_size > 0)
+		{
+			generator.reset(new TiledGenerator(request.algorithm, request.tile_size, &ThreadPool::shared()));
+		}
+		else
+		{
+			generator = MazeGenerator::create(request.algorithm);
 		}
+		m_maze.reset(new Maze(request.width, request.height, request.seed, *generator));
+		m_goals = request.goals;
+		if (m_goals.empty()) m_goals.push_back({ request.width - 1, request.height - 1 });
+		m_index.reset(new MazeIndex(*m_maze));
 	}
 
+private:
+	std::unique_ptr<Maze> m_maze;
+	std::unique_ptr<MazeIndex> m_index;
 
-	tinygltf::TinyGLTF gltf;
-	gltf.WriteGltfSceneToFile(&m_out, model_path.c_str(), true, true, false, true);
+	// the goals' distance field, found on the first solve
+	std::vector<Maze::CellLocation> m_goals;
+	bool m_analyzed = false;
+	std::vector<uint8_t> m_moves;
 
-	Napi::Env env = info.Env();
-	
-	std::vector<Maze::CellLocation> farthests;
-	maze.analyze(farthests);
+	bool ToCell(Napi::Env env, const Napi::Value& value, Maze::CellLocation& loc)
+	{
+		if (m_index == nullptr || !value.IsObject())
+		{
+			Napi::TypeError::New(env, "Expected a cell {x, y}").ThrowAsJavaScriptException();
+			return false;
+		}
+		Napi::Object obj = value.As<Napi::Object>();
+		loc.x = obj.Get("x").ToNumber().Int32Value();
+		loc.y = obj.Get("y").ToNumber().Int32Value();
+		if (loc.x < 0 || loc.x >= m_index->width() || loc.y < 0 || loc.y >= m_index->height())
+		{
+			Napi::RangeError::New(env, "Cell outside the maze").ThrowAsJavaScriptException();
+			return false;
+		}
+		return true;
+	}
 
-	Napi::Array ret = Napi::Array::New(env, 6);
-	for (int i = 0; i < 6; i++)
+	Napi::Value Distance(const Napi::CallbackInfo& info)
 	{
-		Maze::CellLocation loc = farthests[i];
-		Napi::Object pos = Napi::Object::New(env);
-		pos.Set("x", Napi::Number::New(env, loc.x));
-		pos.Set("y", Napi::Number::New(env, loc.y));
-		ret.Set(i, pos);
+		Napi::Env env = info.Env();
+		Maze::CellLocation a, b;
+		if (!ToCell(env, info[0], a) || !ToCell(env, info[1], b)) return env.Undefined();
+		return Napi::Number::New(env, m_index->distance(a, b));
 	}
 
-	return ret;
-}
+	Napi::Value PathLengthVia(const Napi::CallbackInfo& info)
+	{
+		Napi::Env env = info.Env();
+		Maze::CellLocation a, b, c;
+		if (!ToCell(env, info[0], a) || !ToCell(env, info[1], b) || !ToCell(env, info[2], c)) return env.Undefined();
+		return Napi::Number::New(env, m_index->path_length_via(a, b, c));
+	}
+
+	// the next cell from a toward b, null once there
+	Napi::Value NextStep(const Napi::CallbackInfo& info)
+	{
+		Napi::Env env = info.Env();
+		Maze::CellLocation a, b, next;
+		if (!ToCell(env, info[0], a) || !ToCell(env, info[1], b)) return env.Undefined();
+		if (!m_index->next_step(a, b, next)) return env.Null();
+
+		Napi::Object ret = Napi::Object::New(env);
+		ret.Set("x", Napi::Number::New(env, next.x));
+		ret.Set("y", Napi::Number::New(env, next.y));
+		return ret;
+	}
+
+	Napi::Value Solve(const Napi::CallbackInfo& info)
+	{
+		Napi::Env env = info.Env();
+		Maze::CellLocation from;
+		if (!ToCell(env, info[0], from)) return env.Undefined();
+		if (!m_analyzed)
+		{
+			std::vector<Maze::CellLocation> farthests;
+			m_maze->analyze(farthests, 1, m_goals);
+			m_analyzed = true;
+		}
+
+		int steps = m_maze->solve(from, m_moves);
+		if (steps < 0) return env.Null();
+
+		Napi::Uint8Array moves = Napi::Uint8Array::New(env, m_moves.size());
+		if (!m_moves.empty()) memcpy(moves.Data(), m_moves.data(), m_moves.size());
+
+		Napi::Object ret = Napi::Object::New(env);
+		ret.Set("steps", Napi::Number::New(env, steps));
+		ret.Set("moves", moves);
+		return ret;
+	}
+};
 
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
-	srand(time(nullptr));
 	exports.Set("createAMaze", Napi::Function::New(env, CreateAMaze));
+	exports.Set("createManyMazes", Napi::Function::New(env, CreateManyMazes));
+	exports.Set("configurePool", Napi::Function::New(env, ConfigurePool));
+	exports.Set("getPoolStats", Napi::Function::New(env, GetPoolStats));
+	exports.Set("MazeIndex", MazeIndexWrap::Define(env));
+
+	// stop the refill threads before the addon is unloaded
+	napi_add_env_cleanup_hook(env, [](void*) { s_pool.reset(); }, nullptr);
 	return exports;
 }
 
 
 NODE_API_MODULE(MazeNode, Init)
-
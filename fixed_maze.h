@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "maze.h"
+
+// Kruskal maze with its size fixed at compile time, for the configurations
+// the server asks for all the time. All storage lives inside the object and
+// every stride is a constant. For the same seed it carves exactly the same
+// walls and finds the same start points as Maze with MazeAlgorithm::Kruskal.
+template <int W, int H>
+class FixedMaze
+{
+public:
+	static constexpr int m_width = W;
+	static constexpr int m_height = H;
+	static constexpr int NUM_CELLS = W * H;
+	static constexpr int NUM_X_WALLS = (W - 1) * H;
+	static constexpr int NUM_WALLS = NUM_X_WALLS + W * (H - 1);
+
+	static_assert(NUM_WALLS <= 32767, "cell and wall indices are stored in 16 bits");
+
+	uint64_t m_seed;
+
+	FixedMaze(uint64_t seed) : m_seed(seed)
+	{
+		generate();
+	}
+
+	unsigned open_dirs(int x, int y) const { return m_cells[x + y * W]; }
+	bool is_open(int x, int y, int dir) const { return (open_dirs(x, y) & (1u << dir)) != 0; }
+	bool has_x_wall(int x, int y) const { return !is_open(x, y, Maze::DIR_POS_X); }
+	bool has_y_wall(int x, int y) const { return !is_open(x, y, Maze::DIR_POS_Y); }
+
+	// same result as Maze::analyze
+	void analyze(std::vector<Maze::CellLocation>& farthests)
+	{
+		analyze(farthests, 6, { W - 1, H - 1 });
+	}
+
+	void analyze(std::vector<Maze::CellLocation>& farthests, int k, Maze::CellLocation goal)
+	{
+		// cells in the order the BFS reaches them, so each distance is one contiguous run
+		std::array<int16_t, NUM_CELLS> order;
+		std::array<int16_t, NUM_CELLS>& steps = m_steps;
+
+		// The maze is a spanning tree: every cell is reached, so the BFS runs exactly
+		// NUM_CELLS times, and the only reached neighbour of a cell is the one it was
+		// entered from, so leaving out that side replaces the visited set.
+		std::array<uint8_t, NUM_CELLS> children;
+		int start = goal.x + goal.y * W;
+		order[0] = (int16_t)start;
+		steps[start] = 0;
+		children[start] = m_cells[start];
+
+		int tail = 1;
+		for (int head = 0; head < NUM_CELLS; head++)
+		{
+			int cell = order[head];
+			int16_t next_steps = (int16_t)(steps[cell] + 1);
+			unsigned dirs = children[cell];
+
+			auto visit = [&](int next, unsigned back)
+			{
+				steps[next] = next_steps;
+				children[next] = (uint8_t)(m_cells[next] & ~back);
+				order[tail++] = (int16_t)next;
+			};
+
+			if (dirs & Maze::OPEN_NEG_X) visit(cell - 1, Maze::OPEN_POS_X);
+			if (dirs & Maze::OPEN_POS_X) visit(cell + 1, Maze::OPEN_NEG_X);
+			if (dirs & Maze::OPEN_NEG_Y) visit(cell - W, Maze::OPEN_POS_Y);
+			if (dirs & Maze::OPEN_POS_Y) visit(cell + W, Maze::OPEN_NEG_Y);
+		}
+
+		// farthest distance first, BFS order within a distance
+		farthests.clear();
+		int end = NUM_CELLS;
+		while (end > 0 && (int)farthests.size() < k)
+		{
+			int begin = end - 1;
+			while (begin > 0 && steps[order[begin - 1]] == steps[order[end - 1]]) begin--;
+			for (int i = begin; i < end && (int)farthests.size() < k; i++)
+			{
+				farthests.push_back({ order[i] % W, order[i] / W });
+			}
+			end = begin;
+		}
+	}
+
+	// same as Maze::take_distances, copied out of the fixed array; every cell is reached
+	void take_distances(std::vector<uint32_t>& distances) const
+	{
+		distances.resize(NUM_CELLS);
+		for (int i = 0; i < NUM_CELLS; i++)
+		{
+			distances[i] = (uint32_t)m_steps[i];
+		}
+	}
+
+private:
+	// open sides of each cell as a mask of Maze::OPEN_* bits
+	std::array<uint8_t, NUM_CELLS> m_cells;
+
+	// distances found by the last analyze
+	std::array<int16_t, NUM_CELLS> m_steps;
+
+	int find(std::array<int16_t, NUM_CELLS>& parent, int i) const
+	{
+		while (parent[i] != i)
+		{
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+
+	// the same wall shuffle as KruskalGenerator, so the same walls come down
+	void generate()
+	{
+		m_cells.fill(0);
+
+		std::array<int16_t, NUM_WALLS> walls;
+		for (int i = 0; i < NUM_WALLS; i++)
+		{
+			walls[i] = (int16_t)i;
+		}
+
+		Random rng(m_seed);
+		for (int i = NUM_WALLS - 1; i > 0; i--)
+		{
+			int j = rng.next_int(i + 1);
+			std::swap(walls[i], walls[j]);
+		}
+
+		std::array<int16_t, NUM_CELLS> parent;
+		for (int i = 0; i < NUM_CELLS; i++)
+		{
+			parent[i] = (int16_t)i;
+		}
+
+		int num_sets = NUM_CELLS;
+		for (int i = 0; i < NUM_WALLS && num_sets > 1; i++)
+		{
+			int wall = walls[i];
+			int id0, id1;
+			unsigned open0, open1;
+			if (wall < NUM_X_WALLS)
+			{
+				id0 = wall % (W - 1) + wall / (W - 1) * W;
+				id1 = id0 + 1;
+				open0 = Maze::OPEN_POS_X;
+				open1 = Maze::OPEN_NEG_X;
+			}
+			else
+			{
+				id0 = wall - NUM_X_WALLS;
+				id1 = id0 + W;
+				open0 = Maze::OPEN_POS_Y;
+				open1 = Maze::OPEN_NEG_Y;
+			}
+
+			int root0 = find(parent, id0);
+			int root1 = find(parent, id1);
+			if (root0 == root1) continue;
+			parent[root1] = (int16_t)root0;
+
+			m_cells[id0] |= open0;
+			m_cells[id1] |= open1;
+			num_sets--;
+		}
+	}
+};
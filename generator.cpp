@@ -0,0 +1,601 @@
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include "generator.h"
+#include "maze.h"
+#include "disjoint_set.h"
+#include "thread_pool.h"
+
+static const int dx[4] = { -1, 1, 0, 0 };
+static const int dy[4] = { 0, 0, -1, 1 };
+
+// collects the directions from (x, y) leading to cells inside the maze whose flag equals 'state'
+static int neighbors_with(const Maze& maze, const std::vector<uint8_t>& flags, int x, int y, uint8_t state, int dirs[4])
+{
+	int count = 0;
+	for (int dir = 0; dir < 4; dir++)
+	{
+		int nx = x + dx[dir];
+		int ny = y + dy[dir];
+		if (nx < 0 || nx >= maze.m_width || ny < 0 || ny >= maze.m_height) continue;
+		if (flags[nx + ny * maze.m_width] == state)
+		{
+			dirs[count++] = dir;
+		}
+	}
+	return count;
+}
+
+bool MazeGenerator::carve(Maze& maze, int x, int y, int dir)
+{
+	maze.open(x, y, dir);
+	return m_observer == nullptr || m_observer->carved(maze, x, y, dir);
+}
+
+// Randomized Kruskal: visit every wall once in shuffled order,
+// removing it if the 2 cells are not yet connected
+class KruskalGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		int w = maze.m_width;
+		int h = maze.m_height;
+		int num_x_walls = (w - 1) * h;
+		int num_walls = num_x_walls + w * (h - 1);
+
+		// walls are numbered x_walls first, then y_walls
+		std::vector<int> walls(num_walls);
+		for (int i = 0; i < num_walls; i++)
+		{
+			walls[i] = i;
+		}
+
+		for (int i = num_walls - 1; i > 0; i--)
+		{
+			int j = rng.next_int(i + 1);
+			std::swap(walls[i], walls[j]);
+		}
+
+		DisjointSet cells(w * h);
+		int num_sets = w * h;
+		for (int i = 0; i < num_walls && num_sets > 1; i++)
+		{
+			int wall = walls[i];
+			int x, y, dir, id1;
+			if (wall < num_x_walls)
+			{
+				x = wall % (w - 1);
+				y = wall / (w - 1);
+				dir = Maze::DIR_POS_X;
+				id1 = x + 1 + y * w;
+			}
+			else
+			{
+				x = (wall - num_x_walls) % w;
+				y = (wall - num_x_walls) / w;
+				dir = Maze::DIR_POS_Y;
+				id1 = x + (y + 1) * w;
+			}
+
+			if (!cells.unite(x + y * w, id1)) continue;
+			if (!carve(maze, x, y, dir)) return;
+			num_sets--;
+		}
+	}
+};
+
+// Depth-first search with an explicit stack
+class BacktrackerGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		int w = maze.m_width;
+		int h = maze.m_height;
+		std::vector<uint8_t> visited(w * h, 0);
+		std::vector<int> stack;
+
+		int start = rng.next_int(w * h);
+		visited[start] = 1;
+		stack.push_back(start);
+
+		while (stack.size() > 0)
+		{
+			int cell = stack.back();
+			int x = cell % w;
+			int y = cell / w;
+
+			int dirs[4];
+			int count = neighbors_with(maze, visited, x, y, 0, dirs);
+			if (count == 0)
+			{
+				stack.pop_back();
+				continue;
+			}
+
+			int dir = dirs[rng.next_int(count)];
+			if (!carve(maze, x, y, dir)) return;
+			int next = x + dx[dir] + (y + dy[dir]) * w;
+			visited[next] = 1;
+			stack.push_back(next);
+		}
+	}
+};
+
+// Loop-erased random walks, giving a uniform spanning tree
+class WilsonGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		int w = maze.m_width;
+		int h = maze.m_height;
+		std::vector<uint8_t> in_tree(w * h, 0);
+		// last direction taken out of each cell by the current walk
+		std::vector<int8_t> walk_dir(w * h, -1);
+
+		in_tree[rng.next_int(w * h)] = 1;
+
+		for (int start = 0; start < w * h; start++)
+		{
+			if (in_tree[start]) continue;
+
+			// walk until the tree is hit, later visits overwrite earlier exits which erases loops
+			int cell = start;
+			while (!in_tree[cell])
+			{
+				int x = cell % w;
+				int y = cell / w;
+				int dir;
+				do
+				{
+					dir = rng.next_int(4);
+				} while (x + dx[dir] < 0 || x + dx[dir] >= w || y + dy[dir] < 0 || y + dy[dir] >= h);
+				walk_dir[cell] = (int8_t)dir;
+				cell = x + dx[dir] + (y + dy[dir]) * w;
+			}
+
+			cell = start;
+			while (!in_tree[cell])
+			{
+				int x = cell % w;
+				int y = cell / w;
+				int dir = walk_dir[cell];
+				if (!carve(maze, x, y, dir)) return;
+				in_tree[cell] = 1;
+				cell = x + dx[dir] + (y + dy[dir]) * w;
+			}
+		}
+	}
+};
+
+// Randomized Prim's: grow from a frontier of cells adjacent to the maze
+class PrimGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		enum : uint8_t { Outside = 0, Frontier = 1, Inside = 2 };
+
+		int w = maze.m_width;
+		int h = maze.m_height;
+		std::vector<uint8_t> state(w * h, Outside);
+		std::vector<int> frontier;
+
+		auto add_cell = [&](int cell)
+		{
+			state[cell] = Inside;
+			int x = cell % w;
+			int y = cell / w;
+			int dirs[4];
+			int count = neighbors_with(maze, state, x, y, Outside, dirs);
+			for (int i = 0; i < count; i++)
+			{
+				int next = x + dx[dirs[i]] + (y + dy[dirs[i]]) * w;
+				state[next] = Frontier;
+				frontier.push_back(next);
+			}
+		};
+
+		add_cell(rng.next_int(w * h));
+
+		while (frontier.size() > 0)
+		{
+			int idx = rng.next_int((int)frontier.size());
+			int cell = frontier[idx];
+			frontier[idx] = frontier.back();
+			frontier.pop_back();
+
+			int x = cell % w;
+			int y = cell / w;
+			int dirs[4];
+			int count = neighbors_with(maze, state, x, y, Inside, dirs);
+			if (!carve(maze, x, y, dirs[rng.next_int(count)])) return;
+			add_cell(cell);
+		}
+	}
+};
+
+// Growing tree, picking the newest active cell or a random one with equal odds
+class GrowingTreeGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		int w = maze.m_width;
+		int h = maze.m_height;
+		std::vector<uint8_t> visited(w * h, 0);
+		std::vector<int> active;
+
+		int start = rng.next_int(w * h);
+		visited[start] = 1;
+		active.push_back(start);
+
+		while (active.size() > 0)
+		{
+			int idx = (int)active.size() - 1;
+			if (rng.next_bool())
+			{
+				idx = rng.next_int((int)active.size());
+			}
+
+			int cell = active[idx];
+			int x = cell % w;
+			int y = cell / w;
+
+			int dirs[4];
+			int count = neighbors_with(maze, visited, x, y, 0, dirs);
+			if (count == 0)
+			{
+				active[idx] = active.back();
+				active.pop_back();
+				continue;
+			}
+
+			int dir = dirs[rng.next_int(count)];
+			if (!carve(maze, x, y, dir)) return;
+			int next = x + dx[dir] + (y + dy[dir]) * w;
+			visited[next] = 1;
+			active.push_back(next);
+		}
+	}
+};
+
+// Random walk until stuck, then hunt row by row for an unvisited cell next to the maze
+class HuntAndKillGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random& rng) override
+	{
+		int w = maze.m_width;
+		int h = maze.m_height;
+		std::vector<uint8_t> visited(w * h, 0);
+
+		// rows above hunt_row are known to be fully visited
+		int hunt_row = 0;
+
+		int cell = rng.next_int(w * h);
+		visited[cell] = 1;
+
+		while (cell >= 0)
+		{
+			int x = cell % w;
+			int y = cell / w;
+
+			int dirs[4];
+			int count = neighbors_with(maze, visited, x, y, 0, dirs);
+			if (count > 0)
+			{
+				int dir = dirs[rng.next_int(count)];
+				if (!carve(maze, x, y, dir)) return;
+				cell = x + dx[dir] + (y + dy[dir]) * w;
+				visited[cell] = 1;
+				continue;
+			}
+
+			// hunt
+			cell = -1;
+			for (int hy = hunt_row; hy < h && cell < 0; hy++)
+			{
+				bool row_done = true;
+				for (int hx = 0; hx < w; hx++)
+				{
+					if (visited[hx + hy * w]) continue;
+					row_done = false;
+
+					count = neighbors_with(maze, visited, hx, hy, 1, dirs);
+					if (count > 0)
+					{
+						if (!carve(maze, hx, hy, dirs[rng.next_int(count)])) return;
+						cell = hx + hy * w;
+						visited[cell] = 1;
+						break;
+					}
+				}
+				if (row_done && hy == hunt_row) hunt_row++;
+			}
+		}
+	}
+};
+
+// Feeds the rows of EllerGenerator into a whole maze,
+// giving the same maze as streaming the rows with the maze's seed
+class EllerMazeGenerator : public MazeGenerator
+{
+public:
+	void generate(Maze& maze, Random&) override
+	{
+		EllerGenerator rows(maze.m_width, maze.m_height, maze.m_seed);
+		std::vector<bool> x_walls;
+		std::vector<bool> y_walls;
+		while (rows.next_row(x_walls, y_walls))
+		{
+			int y = rows.row() - 1;
+			for (int x = 0; x < maze.m_width - 1; x++)
+			{
+				if (!x_walls[x] && !carve(maze, x, y, Maze::DIR_POS_X)) return;
+			}
+			for (int x = 0; x < maze.m_width && y < maze.m_height - 1; x++)
+			{
+				if (!y_walls[x] && !carve(maze, x, y, Maze::DIR_POS_Y)) return;
+			}
+		}
+	}
+};
+
+TiledGenerator::TiledGenerator(MazeAlgorithm algorithm, int tile_size, ThreadPool* pool)
+	: m_algorithm(algorithm)
+	, m_tile_size(tile_size < 2 ? 2 : tile_size)
+	, m_pool(pool)
+{
+}
+
+void TiledGenerator::generate(Maze& maze, Random& rng)
+{
+	int w = maze.m_width;
+	int h = maze.m_height;
+
+	// the last tile of a row or column absorbs the remainder
+	int tiles_x = w / m_tile_size > 0 ? w / m_tile_size : 1;
+	int tiles_y = h / m_tile_size > 0 ? h / m_tile_size : 1;
+	auto tile_start_x = [&](int tx) { return tx < tiles_x ? tx * m_tile_size : w; };
+	auto tile_start_y = [&](int ty) { return ty < tiles_y ? ty * m_tile_size : h; };
+
+	// tile seeds are drawn up front so the result does not depend on the thread count
+	int num_tiles = tiles_x * tiles_y;
+	std::vector<uint64_t> seeds(num_tiles);
+	for (int i = 0; i < num_tiles; i++)
+	{
+		seeds[i] = rng.next();
+	}
+
+	std::mutex mutex;
+	auto generate_tile = [&](int i)
+	{
+		int tx = i % tiles_x;
+		int ty = i / tiles_x;
+		int x0 = tile_start_x(tx);
+		int y0 = tile_start_y(ty);
+		int tw = tile_start_x(tx + 1) - x0;
+		int th = tile_start_y(ty + 1) - y0;
+
+		Maze tile(tw, th, seeds[i], m_algorithm);
+
+		// tiles only share words of the cell grid when they do not start on a word boundary
+		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+		if (m_tile_size % Maze::CELLS_PER_WORD != 0) lock.lock();
+
+		for (int y = 0; y < th; y++)
+		{
+			for (int x = 0; x < tw; x++)
+			{
+				unsigned dirs = tile.open_dirs(x, y);
+				if (dirs & Maze::OPEN_POS_X) maze.open(x0 + x, y0 + y, Maze::DIR_POS_X);
+				if (dirs & Maze::OPEN_POS_Y) maze.open(x0 + x, y0 + y, Maze::DIR_POS_Y);
+			}
+		}
+	};
+
+	if (m_pool != nullptr)
+	{
+		m_pool->parallel_for(num_tiles, generate_tile);
+	}
+	else
+	{
+		for (int i = 0; i < num_tiles; i++)
+		{
+			generate_tile(i);
+		}
+	}
+
+	// Kruskal over the tile grid, edges numbered horizontal first, then vertical
+	int num_h_edges = (tiles_x - 1) * tiles_y;
+	int num_edges = num_h_edges + tiles_x * (tiles_y - 1);
+	std::vector<int> edges(num_edges);
+	for (int i = 0; i < num_edges; i++)
+	{
+		edges[i] = i;
+	}
+	for (int i = num_edges - 1; i > 0; i--)
+	{
+		std::swap(edges[i], edges[rng.next_int(i + 1)]);
+	}
+
+	DisjointSet tiles(num_tiles);
+	for (int i = 0; i < num_edges; i++)
+	{
+		int edge = edges[i];
+		if (edge < num_h_edges)
+		{
+			int tx = edge % (tiles_x - 1);
+			int ty = edge / (tiles_x - 1);
+			if (!tiles.unite(tx + ty * tiles_x, tx + 1 + ty * tiles_x)) continue;
+
+			int y0 = tile_start_y(ty);
+			int y = y0 + rng.next_int(tile_start_y(ty + 1) - y0);
+			maze.open(tile_start_x(tx + 1) - 1, y, Maze::DIR_POS_X);
+		}
+		else
+		{
+			int tx = (edge - num_h_edges) % tiles_x;
+			int ty = (edge - num_h_edges) / tiles_x;
+			if (!tiles.unite(tx + ty * tiles_x, tx + (ty + 1) * tiles_x)) continue;
+
+			int x0 = tile_start_x(tx);
+			int x = x0 + rng.next_int(tile_start_x(tx + 1) - x0);
+			maze.open(x, tile_start_y(ty + 1) - 1, Maze::DIR_POS_Y);
+		}
+	}
+}
+
+EllerGenerator::EllerGenerator(int width, int height, uint64_t seed)
+	: m_width(width)
+	, m_height(height)
+	, m_row(0)
+	, m_rng(seed)
+	, m_sets(width, -1)
+	, m_parent(width)
+	, m_first(width)
+	, m_last(width)
+	, m_dropped(width)
+{
+}
+
+int EllerGenerator::find(int i)
+{
+	while (m_parent[i] != i)
+	{
+		m_parent[i] = m_parent[m_parent[i]];
+		i = m_parent[i];
+	}
+	return i;
+}
+
+bool EllerGenerator::next_row(std::vector<bool>& x_walls, std::vector<bool>& y_walls)
+{
+	if (m_row >= m_height) return false;
+
+	int w = m_width;
+	bool last = m_row == m_height - 1;
+	x_walls.assign(w - 1, true);
+	y_walls.assign(w, true);
+
+	// cells carried down from the same set start out connected
+	for (int x = 0; x < w; x++)
+	{
+		m_parent[x] = x;
+		m_first[x] = -1;
+	}
+	for (int x = 0; x < w; x++)
+	{
+		int set = m_sets[x];
+		if (set < 0) continue;
+		if (m_first[set] < 0)
+		{
+			m_first[set] = x;
+		}
+		else
+		{
+			m_parent[x] = m_first[set];
+		}
+	}
+
+	// randomly join neighbors of different sets, the last row joins all of them
+	for (int x = 0; x < w - 1; x++)
+	{
+		int a = find(x);
+		int b = find(x + 1);
+		if (a != b && (last || m_rng.next_bool()))
+		{
+			x_walls[x] = false;
+			m_parent[b] = a;
+		}
+	}
+
+	if (!last)
+	{
+		// every set continues down through at least one cell
+		for (int x = 0; x < w; x++)
+		{
+			int root = find(x);
+			m_last[root] = x;
+			m_dropped[root] = false;
+		}
+		for (int x = 0; x < w; x++)
+		{
+			int root = find(x);
+			if (m_rng.next_bool() || (m_last[root] == x && !m_dropped[root]))
+			{
+				y_walls[x] = false;
+				m_dropped[root] = true;
+			}
+		}
+		for (int x = 0; x < w; x++)
+		{
+			m_sets[x] = y_walls[x] ? -1 : find(x);
+		}
+	}
+
+	m_row++;
+	return true;
+}
+
+static const struct
+{
+	const char* name;
+	MazeAlgorithm algorithm;
+} s_algorithms[] = {
+	{ "kruskal", MazeAlgorithm::Kruskal },
+	{ "backtracker", MazeAlgorithm::Backtracker },
+	{ "wilson", MazeAlgorithm::Wilson },
+	{ "prim", MazeAlgorithm::Prim },
+	{ "growing_tree", MazeAlgorithm::GrowingTree },
+	{ "hunt_and_kill", MazeAlgorithm::HuntAndKill },
+	{ "eller", MazeAlgorithm::Eller },
+};
+
+bool parse_algorithm(const char* name, MazeAlgorithm& algorithm)
+{
+	for (auto& entry : s_algorithms)
+	{
+		if (strcmp(entry.name, name) == 0)
+		{
+			algorithm = entry.algorithm;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* algorithm_name(MazeAlgorithm algorithm)
+{
+	for (auto& entry : s_algorithms)
+	{
+		if (entry.algorithm == algorithm) return entry.name;
+	}
+	return "unknown";
+}
+
+std::unique_ptr<MazeGenerator> MazeGenerator::create(MazeAlgorithm algorithm)
+{
+	switch (algorithm)
+	{
+	case MazeAlgorithm::Backtracker:
+		return std::unique_ptr<MazeGenerator>(new BacktrackerGenerator);
+	case MazeAlgorithm::Wilson:
+		return std::unique_ptr<MazeGenerator>(new WilsonGenerator);
+	case MazeAlgorithm::Prim:
+		return std::unique_ptr<MazeGenerator>(new PrimGenerator);
+	case MazeAlgorithm::GrowingTree:
+		return std::unique_ptr<MazeGenerator>(new GrowingTreeGenerator);
+	case MazeAlgorithm::HuntAndKill:
+		return std::unique_ptr<MazeGenerator>(new HuntAndKillGenerator);
+	case MazeAlgorithm::Eller:
+		return std::unique_ptr<MazeGenerator>(new EllerMazeGenerator);
+	default:
+		return std::unique_ptr<MazeGenerator>(new KruskalGenerator);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "random.h"
+
+class Maze;
+class ThreadPool;
+
+enum class MazeAlgorithm
+{
+	Kruskal,
+	Backtracker,
+	Wilson,
+	Prim,
+	GrowingTree,
+	HuntAndKill,
+	Eller,
+};
+
+bool parse_algorithm(const char* name, MazeAlgorithm& algorithm);
+const char* algorithm_name(MazeAlgorithm algorithm);
+
+// Told about every wall a generator removes
+class CarveObserver
+{
+public:
+	virtual ~CarveObserver() {}
+
+	// called after the wall on side dir of (x, y) is opened, returning false abandons the maze
+	virtual bool carved(const Maze& maze, int x, int y, int dir) = 0;
+};
+
+// Carves a perfect maze into a Maze whose walls are all closed
+class MazeGenerator
+{
+public:
+	virtual ~MazeGenerator() {}
+	virtual void generate(Maze& maze, Random& rng) = 0;
+
+	// An abandoned maze is left half carved. TiledGenerator does not report its carving.
+	void set_observer(CarveObserver* observer) { m_observer = observer; }
+
+	static std::unique_ptr<MazeGenerator> create(MazeAlgorithm algorithm);
+
+protected:
+	CarveObserver* m_observer = nullptr;
+
+	// opens the wall and reports it, false if the observer abandons the maze
+	bool carve(Maze& maze, int x, int y, int dir);
+};
+
+// Splits the maze into tiles, generates a perfect maze in each tile
+// concurrently, then joins the tiles through a random spanning tree
+// over the tile grid, opening one border wall per tree edge
+class TiledGenerator : public MazeGenerator
+{
+public:
+	// without a pool the tiles are generated on the calling thread
+	TiledGenerator(MazeAlgorithm algorithm, int tile_size, ThreadPool* pool);
+
+	void generate(Maze& maze, Random& rng) override;
+
+private:
+	MazeAlgorithm m_algorithm;
+	int m_tile_size;
+	ThreadPool* m_pool;
+};
+
+// Eller's algorithm, producing the maze one row at a time with O(width) state
+class EllerGenerator
+{
+public:
+	EllerGenerator(int width, int height, uint64_t seed);
+
+	// Produces the next row: x_walls gets the width - 1 walls right of its cells,
+	// y_walls the width walls below it (all closed for the last row).
+	// Returns false once all rows have been produced.
+	bool next_row(std::vector<bool>& x_walls, std::vector<bool>& y_walls);
+
+	// index of the next row to be produced
+	int row() const { return m_row; }
+
+private:
+	int m_width;
+	int m_height;
+	int m_row;
+	Random m_rng;
+
+	// set of each cell of the current row, -1 for cells not joined from above
+	std::vector<int> m_sets;
+
+	// per-row scratch, indexed by cell or by set
+	std::vector<int> m_parent;
+	std::vector<int> m_first;
+	std::vector<int> m_last;
+	std::vector<bool> m_dropped;
+
+	int find(int i);
+};
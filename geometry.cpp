@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 
 #define TINYGLTF_IMPLEMENTATION
@@ -10,878 +13,506 @@
 
 const float Geometry::unit = 0.0625f;
 
-void Geometry::to_gltf(tinygltf::Model& m_out, tinygltf::Primitive& prim_out)
+void Geometry::reserve(size_t num_vertices, size_t num_faces)
 {
-	tinygltf::Buffer& buf_out = m_out.buffers[0];
+	faces.reserve(faces.size() + num_faces);
+	positions.reserve(positions.size() + num_vertices);
+	normals.reserve(normals.size() + num_vertices);
+	texcoords.reserve(texcoords.size() + num_vertices);
+}
+
+void GeometryStats::add(const Geometry& geo)
+{
+	num_vertices += geo.positions.size();
+	num_faces += geo.faces.size();
+	for (const glm::vec3& pos : geo.positions)
+	{
+		min_pos = { std::min(min_pos.x, pos.x), std::min(min_pos.y, pos.y), std::min(min_pos.z, pos.z) };
+		max_pos = { std::max(max_pos.x, pos.x), std::max(max_pos.y, pos.y), std::max(max_pos.z, pos.z) };
+	}
+	for (const glm::vec2& uv : geo.texcoords)
+	{
+		max_uv = { std::max(max_uv.x, uv.x), std::max(max_uv.y, uv.y) };
+	}
+}
 
-	int num_pos = (int)positions.size();
-	int num_face = (int)faces.size();
+glm::vec2 GeometryStats::uv_scale() const
+{
+	return { ceilf(max_uv.x), ceilf(max_uv.y) };
+}
 
-	size_t offset = 0;
-	size_t length = 0;
-	size_t view_id = 0;
-	size_t acc_id = 0;
+bool GltfSink::align()
+{
+	static const uint8_t zeros[4] = {};
+	size_t padding = (4 - (m_offset & 3)) & 3;
+	return padding == 0 || write(zeros, padding);
+}
 
-	offset = buf_out.data.size();
-	length = sizeof(glm::ivec3) * num_face;
-	buf_out.data.resize(offset + length);
-	memcpy(buf_out.data.data() + offset, faces.data(), length);
+bool GltfBufferSink::put(const void* data, size_t length)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	m_data.insert(m_data.end(), bytes, bytes + length);
+	return true;
+}
 
-	view_id = m_out.bufferViews.size();
-	{
-		tinygltf::BufferView view;
-		view.buffer = 0;
-		view.byteOffset = offset;
-		view.byteLength = length;
-		view.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
-		m_out.bufferViews.push_back(view);
-	}
+GeometryStats Geometry::stats() const
+{
+	GeometryStats stats;
+	stats.add(*this);
+	return stats;
+}
+
+// How the views of a primitive are encoded, decided from its stats
+struct Encoding
+{
+	bool quantized;
+	bool short_indices;
+	bool short_positions;
+
+	// quantized, the bounds of the positions in units
+	glm::ivec3 min_units;
+	glm::ivec3 max_units;
+
+	glm::vec2 uv_scale;
+};
+
+static Encoding get_encoding(const GeometryStats& stats, bool quantized)
+{
+	Encoding enc;
+	enc.quantized = quantized;
+
+	// uint16 indices leave out 65535, the primitive restart value
+	enc.short_indices = quantized && stats.num_vertices < 65536;
+
+	// rounding keeps the order, so the bounds in units are the rounded bounds
+	enc.min_units = { (int)lroundf(stats.min_pos.x / Geometry::unit), (int)lroundf(stats.min_pos.y / Geometry::unit), (int)lroundf(stats.min_pos.z / Geometry::unit) };
+	enc.max_units = { (int)lroundf(stats.max_pos.x / Geometry::unit), (int)lroundf(stats.max_pos.y / Geometry::unit), (int)lroundf(stats.max_pos.z / Geometry::unit) };
+	enc.short_positions = quantized
+		&& enc.min_units.x >= INT16_MIN && enc.min_units.y >= INT16_MIN && enc.min_units.z >= INT16_MIN
+		&& enc.max_units.x <= INT16_MAX && enc.max_units.y <= INT16_MAX && enc.max_units.z <= INT16_MAX;
+
+	enc.uv_scale = stats.uv_scale();
+	return enc;
+}
+
+// Appends a buffer view of length bytes, aligned to 4 as vertex attributes must be,
+// and moves offset past it.
+static int add_view(tinygltf::Model& m_out, size_t& offset, size_t length, size_t stride, int target)
+{
+	offset = (offset + 3) & ~(size_t)3;
+
+	tinygltf::BufferView view;
+	view.buffer = 0;
+	view.byteOffset = offset;
+	view.byteLength = length;
+	view.byteStride = stride;
+	view.target = target;
+	m_out.bufferViews.push_back(view);
+
+	offset += length;
+	return (int)m_out.bufferViews.size() - 1;
+}
+
+size_t Geometry::gltf_layout(tinygltf::Model& m_out, tinygltf::Primitive& prim_out, const GeometryStats& stats, bool quantized, size_t offset)
+{
+	Encoding enc = get_encoding(stats, quantized);
+	size_t num_pos = stats.num_vertices;
+	size_t num_face = stats.num_faces;
 
-	acc_id = m_out.accessors.size();
 	{
 		tinygltf::Accessor acc;
-		acc.bufferView = view_id;
+		size_t index_size = enc.short_indices ? sizeof(uint16_t) : sizeof(uint32_t);
+		acc.bufferView = add_view(m_out, offset, index_size * 3 * num_face, 0, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
 		acc.byteOffset = 0;
-		acc.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
-		acc.count = (size_t)(num_face * 3);
+		acc.componentType = enc.short_indices ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT : TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+		acc.count = num_face * 3;
 		acc.type = TINYGLTF_TYPE_SCALAR;
 		acc.maxValues = { (double)(num_pos - 1) };
 		acc.minValues = { 0 };
+		prim_out.indices = (int)m_out.accessors.size();
 		m_out.accessors.push_back(acc);
 	}
 
-	prim_out.indices = acc_id;
-
-	glm::vec3 min_pos = { FLT_MAX, FLT_MAX, FLT_MAX };
-	glm::vec3 max_pos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
-
-	for (int k = 0; k < num_pos; k++)
-	{
-		glm::vec3 pos = positions[k];
-		if (pos.x < min_pos.x) min_pos.x = pos.x;
-		if (pos.x > max_pos.x) max_pos.x = pos.x;
-		if (pos.y < min_pos.y) min_pos.y = pos.y;
-		if (pos.y > max_pos.y) max_pos.y = pos.y;
-		if (pos.z < min_pos.z) min_pos.z = pos.z;
-		if (pos.z > max_pos.z) max_pos.z = pos.z;
-	}
-
-	offset = buf_out.data.size();
-	length = sizeof(glm::vec3) * num_pos;
-	buf_out.data.resize(offset + length);
-	memcpy(buf_out.data.data() + offset, positions.data(), length);
-
-	view_id = m_out.bufferViews.size();
-	{
-		tinygltf::BufferView view;
-		view.buffer = 0;
-		view.byteOffset = offset;
-		view.byteLength = length;
-		view.target = TINYGLTF_TARGET_ARRAY_BUFFER;
-		m_out.bufferViews.push_back(view);
-	}
-
-	acc_id = m_out.accessors.size();
+	// quantized positions are whole units, int16 padded to 4 components as attributes are aligned to 4 bytes
 	{
 		tinygltf::Accessor acc;
-		acc.bufferView = view_id;
 		acc.byteOffset = 0;
-		acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		acc.count = (size_t)(num_pos);
+		acc.componentType = enc.short_positions ? TINYGLTF_COMPONENT_TYPE_SHORT : TINYGLTF_COMPONENT_TYPE_FLOAT;
+		acc.count = num_pos;
 		acc.type = TINYGLTF_TYPE_VEC3;
-		acc.maxValues = { max_pos.x, max_pos.y, max_pos.z };
-		acc.minValues = { min_pos.x, min_pos.y, min_pos.z };
+		if (enc.short_positions)
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(int16_t) * 4 * num_pos, sizeof(int16_t) * 4, TINYGLTF_TARGET_ARRAY_BUFFER);
+		}
+		else
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(glm::vec3) * num_pos, 0, TINYGLTF_TARGET_ARRAY_BUFFER);
+		}
+		if (quantized)
+		{
+			acc.maxValues = { (double)enc.max_units.x, (double)enc.max_units.y, (double)enc.max_units.z };
+			acc.minValues = { (double)enc.min_units.x, (double)enc.min_units.y, (double)enc.min_units.z };
+		}
+		else
+		{
+			acc.maxValues = { stats.max_pos.x, stats.max_pos.y, stats.max_pos.z };
+			acc.minValues = { stats.min_pos.x, stats.min_pos.y, stats.min_pos.z };
+		}
+		prim_out.attributes["POSITION"] = (int)m_out.accessors.size();
 		m_out.accessors.push_back(acc);
 	}
 
-	prim_out.attributes["POSITION"] = acc_id;
-
-	offset = buf_out.data.size();
-	length = sizeof(glm::vec3) * num_pos;
-	buf_out.data.resize(offset + length);
-	memcpy(buf_out.data.data() + offset, normals.data(), length);
-
-	view_id = m_out.bufferViews.size();
-	{
-		tinygltf::BufferView view;
-		view.buffer = 0;
-		view.byteOffset = offset;
-		view.byteLength = length;
-		view.target = TINYGLTF_TARGET_ARRAY_BUFFER;
-		m_out.bufferViews.push_back(view);
-	}
-
-	acc_id = m_out.accessors.size();
+	// normals are axis aligned, exact in int8
 	{
 		tinygltf::Accessor acc;
-		acc.bufferView = view_id;
+		if (quantized)
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(int8_t) * 4 * num_pos, sizeof(int8_t) * 4, TINYGLTF_TARGET_ARRAY_BUFFER);
+			acc.componentType = TINYGLTF_COMPONENT_TYPE_BYTE;
+			acc.normalized = true;
+		}
+		else
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(glm::vec3) * num_pos, 0, TINYGLTF_TARGET_ARRAY_BUFFER);
+			acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		}
 		acc.byteOffset = 0;
-		acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		acc.count = (size_t)(num_pos);
+		acc.count = num_pos;
 		acc.type = TINYGLTF_TYPE_VEC3;
+		prim_out.attributes["NORMAL"] = (int)m_out.accessors.size();
 		m_out.accessors.push_back(acc);
 	}
 
-	prim_out.attributes["NORMAL"] = acc_id;	
-
-	offset = buf_out.data.size();
-	length = sizeof(glm::vec2) * num_pos;
-	buf_out.data.resize(offset + length);
-	memcpy(buf_out.data.data() + offset, texcoords.data(), length);
-
-	view_id = m_out.bufferViews.size();
-	{
-		tinygltf::BufferView view;
-		view.buffer = 0;
-		view.byteOffset = offset;
-		view.byteLength = length;
-		view.target = TINYGLTF_TARGET_ARRAY_BUFFER;
-		m_out.bufferViews.push_back(view);
-	}
-
-	acc_id = m_out.accessors.size();
 	{
 		tinygltf::Accessor acc;
-		acc.bufferView = view_id;
+		if (quantized)
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(uint16_t) * 2 * num_pos, 0, TINYGLTF_TARGET_ARRAY_BUFFER);
+			acc.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+			acc.normalized = true;
+		}
+		else
+		{
+			acc.bufferView = add_view(m_out, offset, sizeof(glm::vec2) * num_pos, 0, TINYGLTF_TARGET_ARRAY_BUFFER);
+			acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		}
 		acc.byteOffset = 0;
-		acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		acc.count = (size_t)(num_pos);
+		acc.count = num_pos;
 		acc.type = TINYGLTF_TYPE_VEC2;
+		prim_out.attributes["TEXCOORD_0"] = (int)m_out.accessors.size();
 		m_out.accessors.push_back(acc);
 	}
 
-	prim_out.attributes["TEXCOORD_0"] = acc_id;
-
+	return offset;
 }
 
-void Geometry::generate_ground(int x_units, int z_units, int offset_x, int offset_y, int offset_z)
-{
-	int idx = (int)positions.size();
-
-	float y = (float)offset_y * unit;
-	float x0 = (float)offset_x * unit;
-	float x1 = x0 + x_units * unit;
-	float z0 = -(float)offset_z * unit;
-	float z1 = z0 - z_units * unit;
-
-	float u0 = 0.0f;
-	float v0 = 1.0f;
-	float u1 = 1.0f;
-	float v1 = 0.0f;
-
-	glm::vec3 norm = { 0.0f, 1.0f, 0.0f };
-
-	positions.push_back({ x0, y, z0 });
-	normals.push_back(norm);	
-	texcoords.push_back({ u0, v0 });
-
-	positions.push_back({ x1, y, z0 });
-	normals.push_back(norm);	
-	texcoords.push_back({ u1, v0 });
-
-	positions.push_back({ x1, y, z1 });
-	normals.push_back(norm);	
-	texcoords.push_back({ u1, v1 });
-
-	positions.push_back({ x0, y, z1 });
-	normals.push_back(norm);	
-	texcoords.push_back({ u0, v1 });
+// The encoders of the views, each taking a run of elements. Floats are written
+// as they are; quantized data is converted a block at a time.
+static const size_t BLOCK = 1024;
 
-	faces.push_back({ idx + 0, idx + 1, idx + 3 });
-	faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-}
-
-void Geometry::generate_pillar(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z)
+static bool write_indices(GltfSink& sink, const glm::ivec3* faces, size_t count, const Encoding& enc)
 {
-	// -x
-	{
-		int idx = (int)positions.size();
-
-		float x = (float)offset_x * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z1 = -(float)offset_z * unit;
-		float z0 = z1 - z_units * unit;
-
-		float u0 = 0.25f;
-		float v0 = 13.0f / 17.0f;
-		float u1 = 0.5f;
-		float v1 = 0.0f;
-		
-		glm::vec3 norm = { -1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-	}
+	if (!enc.short_indices) return sink.write(faces, sizeof(glm::ivec3) * count);
 
-	// +x
+	uint16_t out[BLOCK * 3];
+	for (size_t start = 0; start < count; start += BLOCK)
 	{
-		int idx = (int)positions.size();
-
-		float x = (float)(offset_x + x_units) * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-		
-		float u0 = 0.0f;
-		float v0 = 13.0f / 17.0f;
-		float u1 = 0.25f;
-		float v1 = 0.0f;		
-
-		glm::vec3 norm = { 1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
+		size_t n = std::min(BLOCK, count - start);
+		for (size_t k = 0; k < n; k++)
+		{
+			out[k * 3] = (uint16_t)faces[start + k].x;
+			out[k * 3 + 1] = (uint16_t)faces[start + k].y;
+			out[k * 3 + 2] = (uint16_t)faces[start + k].z;
+		}
+		if (!sink.write(out, sizeof(uint16_t) * 3 * n)) return false;
 	}
+	return true;
+}
 
-	// -y
-	{
-		int idx = (int)positions.size();
-
-		float y = (float)offset_y * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float z1 = -(float)offset_z * unit;
-		float z0 = z1 - z_units * unit;
-
-		float u0 = 0.25f;
-		float v0 = 1.0f;
-		float u1 = 0.5f;
-		float v1 = 13.0f / 17.0f;
-
-		glm::vec3 norm = { 0.0f, -1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-	}
-
-	// y
-	{
-		int idx = (int)positions.size();
-
-		float y = (float)(offset_y + y_units) * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 1.0f;
-		float u1 = 0.25f;
-		float v1 = 13.0f / 17.0f;
-
-		glm::vec3 norm = { 0.0f, 1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-	}
-
-	// -z
-	{
-		int idx = (int)positions.size();
-
-		float z = -(float)(offset_z + z_units) * unit;
-		float x1 = (float)offset_x * unit;
-		float x0 = x1 + x_units * unit;
-
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		
-		float u0 = 0.75f;
-		float v0 = 13.0f / 17.0f;
-		float u1 = 1.0f;
-		float v1 = 0.0f;
-
-		glm::vec3 norm = { 0.0f, 0.0f, -1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-	}
+static bool write_positions(GltfSink& sink, const glm::vec3* positions, size_t count, const Encoding& enc)
+{
+	if (!enc.quantized) return sink.write(positions, sizeof(glm::vec3) * count);
 
-	// z
+	int16_t out[BLOCK * 4];
+	glm::vec3 out_float[BLOCK];
+	for (size_t start = 0; start < count; start += BLOCK)
 	{
-		int idx = (int)positions.size();
-
-		float z = -(float)offset_z * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-	
-		float u0 = 0.5f;
-		float v0 = 13.0f / 17.0f;
-		float u1 = 0.75f;
-		float v1 = 0.0f;
-	
-		glm::vec3 norm = { 0.0f, 0.0f, 1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);	
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);	
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);		
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);		
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
+		size_t n = std::min(BLOCK, count - start);
+		const glm::vec3* in = positions + start;
+		if (!enc.short_positions)
+		{
+			for (size_t k = 0; k < n; k++)
+			{
+				out_float[k] = { in[k].x / Geometry::unit, in[k].y / Geometry::unit, in[k].z / Geometry::unit };
+			}
+			if (!sink.write(out_float, sizeof(glm::vec3) * n)) return false;
+			continue;
+		}
+		for (size_t k = 0; k < n; k++)
+		{
+			out[k * 4] = (int16_t)lroundf(in[k].x / Geometry::unit);
+			out[k * 4 + 1] = (int16_t)lroundf(in[k].y / Geometry::unit);
+			out[k * 4 + 2] = (int16_t)lroundf(in[k].z / Geometry::unit);
+			out[k * 4 + 3] = 0;
+		}
+		if (!sink.write(out, sizeof(int16_t) * 4 * n)) return false;
 	}
-
+	return true;
 }
 
-void Geometry::generate_wall_x(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z)
+static bool write_normals(GltfSink& sink, const glm::vec3* normals, size_t count, const Encoding& enc)
 {
-	// -x
-	{
-		int idx = (int)positions.size();
-
-		float x = (float)offset_x * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z1 = -(float)offset_z * unit;
-		float z0 = z1 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 96.0f/120.0f;
-		float u1 = 96.0f/108.0f;
-		float v1 = 48.0f/120.0f;
-
-		glm::vec3 norm = { -1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-	}
-
-	// +x
-	{
-		int idx = (int)positions.size();
-
-		float x = (float)(offset_x + x_units) * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 48.0f / 120.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 0.0f;
-
-		glm::vec3 norm = { 1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
+	if (!enc.quantized) return sink.write(normals, sizeof(glm::vec3) * count);
 
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-	}
-
-	// -y
+	int8_t out[BLOCK * 4];
+	for (size_t start = 0; start < count; start += BLOCK)
 	{
-		int idx = (int)positions.size();
-
-		float y = (float)offset_y * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 1.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 108.0f / 120.0f;
-
-		glm::vec3 norm = { 0.0f, -1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
+		size_t n = std::min(BLOCK, count - start);
+		const glm::vec3* in = normals + start;
+		for (size_t k = 0; k < n; k++)
+		{
+			out[k * 4] = (int8_t)lroundf(in[k].x * 127.0f);
+			out[k * 4 + 1] = (int8_t)lroundf(in[k].y * 127.0f);
+			out[k * 4 + 2] = (int8_t)lroundf(in[k].z * 127.0f);
+			out[k * 4 + 3] = 0;
+		}
+		if (!sink.write(out, sizeof(int8_t) * 4 * n)) return false;
 	}
+	return true;
+}
 
-	// y
-	{
-		int idx = (int)positions.size();
-
-		float y = (float)(offset_y + y_units) * unit;
-		float x1 = (float)offset_x * unit;
-		float x0 = x1 + x_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 108.0f / 120.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 96.0f / 120.0f;
-
-		glm::vec3 norm = { 0.0f, 1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-	}
+static bool write_texcoords(GltfSink& sink, const glm::vec2* texcoords, size_t count, const Encoding& enc)
+{
+	if (!enc.quantized) return sink.write(texcoords, sizeof(glm::vec2) * count);
 
-	// -z
+	uint16_t out[BLOCK * 2];
+	for (size_t start = 0; start < count; start += BLOCK)
 	{
-		int idx = (int)positions.size();
-
-		float z = -(float)(offset_z + z_units) * unit;
-		float x1 = (float)offset_x * unit;
-		float x0 = x1 + x_units * unit;
-
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-
-		float u0 = 96.0f / 108.0f;
-		float v0 = 96.0f / 120.0f;
-		float u1 = 1.0f;
-		float v1 = 48.0f/120.0f;
-
-		glm::vec3 norm = { 0.0f, 0.0f, -1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
+		size_t n = std::min(BLOCK, count - start);
+		const glm::vec2* in = texcoords + start;
+		for (size_t k = 0; k < n; k++)
+		{
+			float u = std::min(std::max(in[k].x / enc.uv_scale.x, 0.0f), 1.0f);
+			float v = std::min(std::max(in[k].y / enc.uv_scale.y, 0.0f), 1.0f);
+			out[k * 2] = (uint16_t)lroundf(u * 65535.0f);
+			out[k * 2 + 1] = (uint16_t)lroundf(v * 65535.0f);
+		}
+		if (!sink.write(out, sizeof(uint16_t) * 2 * n)) return false;
 	}
+	return true;
+}
 
-	// z
-	{
-		int idx = (int)positions.size();
-
-		float z = -(float)offset_z * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-
-		float u0 = 96.0f / 108.0f;
-		float v0 = 48.0f / 120.0f;
-		float u1 = 1.0f;
-		float v1 = 0.0f;
-
-		glm::vec3 norm = { 0.0f, 0.0f, 1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
-	}
+bool Geometry::write_gltf(GltfSink& sink, const GeometryStats& stats, bool quantized) const
+{
+	Encoding enc = get_encoding(stats, quantized);
+	return sink.align() && write_indices(sink, faces.data(), faces.size(), enc)
+		&& sink.align() && write_positions(sink, positions.data(), positions.size(), enc)
+		&& sink.align() && write_normals(sink, normals.data(), normals.size(), enc)
+		&& sink.align() && write_texcoords(sink, texcoords.data(), texcoords.size(), enc);
+}
 
+void Geometry::to_gltf(tinygltf::Model& m_out, tinygltf::Primitive& prim_out, bool quantized) const
+{
+	GeometryStats stats = this->stats();
+	std::vector<unsigned char>& data = m_out.buffers[0].data;
+	gltf_layout(m_out, prim_out, stats, quantized, data.size());
 
+	GltfBufferSink sink(data);
+	write_gltf(sink, stats, quantized);
 }
 
-void Geometry::generate_wall_z(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z)
+void GeometrySpool::append(Geometry& geo)
 {
-	// -x
+	int base = (int)m_stats.num_vertices;
+	if (base > 0)
 	{
-		int idx = (int)positions.size();
-
-		float x = (float)offset_x * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z1 = -(float)offset_z * unit;
-		float z0 = z1 - z_units * unit;
-
-		float u0 = 96.0f / 108.0f;
-		float v0 = 96.0f / 120.0f;
-		float u1 = 1.0f;
-		float v1 = 48.0f / 120.0f;
-
-		glm::vec3 norm = { -1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
+		for (glm::ivec3& face : geo.faces)
+		{
+			face = { face.x + base, face.y + base, face.z + base };
+		}
 	}
+	m_stats.add(geo);
 
-	// +x
-	{
-		int idx = (int)positions.size();
-
-		float x = (float)(offset_x + x_units) * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 96.0f / 108.0f;
-		float v0 = 48.0f / 120.0f;
-		float u1 = 1.0f;
-		float v1 = 0.0f;
+	m_faces.write(geo.faces.data(), sizeof(glm::ivec3) * geo.faces.size());
+	m_positions.write(geo.positions.data(), sizeof(glm::vec3) * geo.positions.size());
+	m_normals.write(geo.normals.data(), sizeof(glm::vec3) * geo.normals.size());
+	m_texcoords.write(geo.texcoords.data(), sizeof(glm::vec2) * geo.texcoords.size());
 
-		glm::vec3 norm = { 1.0f, 0.0f, 0.0f };
-
-		positions.push_back({ x, y0, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x, y0, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x, y1, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x, y1, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
+	geo.faces.clear();
+	geo.positions.clear();
+	geo.normals.clear();
+	geo.texcoords.clear();
+}
 
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-	}
+// reads count elements of type T back from the file, a block at a time, for the encoder
+template <class T, class Encoder>
+static bool write_spooled(GltfSink& sink, SpoolFile& file, size_t count, Encoder encode)
+{
+	if (!file.rewind() || !sink.align()) return false;
 
-	// -y
+	std::vector<T> block(BLOCK);
+	for (size_t start = 0; start < count; start += BLOCK)
 	{
-		int idx = (int)positions.size();
-
-		float y = (float)offset_y * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float z1 = -(float)offset_z * unit;
-		float z0 = z1 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 1.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 108.0f / 120.0f;
-
-		glm::vec3 norm = { 0.0f, -1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
+		size_t n = std::min(BLOCK, count - start);
+		if (file.read(block.data(), sizeof(T) * n) != sizeof(T) * n) return false;
+		if (!encode(sink, block.data(), n)) return false;
 	}
+	return true;
+}
 
-	// y
-	{
-		int idx = (int)positions.size();
-
-		float y = (float)(offset_y + y_units) * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float z0 = -(float)offset_z * unit;
-		float z1 = z0 - z_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 108.0f / 120.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 96.0f / 120.0f;
-
-		glm::vec3 norm = { 0.0f, 1.0f, 0.0f };
-
-		positions.push_back({ x0, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y, z0 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y, z1 });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
+bool GeometrySpool::write_gltf(GltfSink& sink, bool quantized)
+{
+	Encoding enc = get_encoding(m_stats, quantized);
+	return write_spooled<glm::ivec3>(sink, m_faces, m_stats.num_faces, [&](GltfSink& out, const glm::ivec3* faces, size_t n) { return write_indices(out, faces, n, enc); })
+		&& write_spooled<glm::vec3>(sink, m_positions, m_stats.num_vertices, [&](GltfSink& out, const glm::vec3* positions, size_t n) { return write_positions(out, positions, n, enc); })
+		&& write_spooled<glm::vec3>(sink, m_normals, m_stats.num_vertices, [&](GltfSink& out, const glm::vec3* normals, size_t n) { return write_normals(out, normals, n, enc); })
+		&& write_spooled<glm::vec2>(sink, m_texcoords, m_stats.num_vertices, [&](GltfSink& out, const glm::vec2* texcoords, size_t n) { return write_texcoords(out, texcoords, n, enc); });
+}
 
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
+// Every piece is a box. A face table lists its six faces in FACE_* order: the
+// corners of each face, a bit per axis for the low or high side, the normal
+// and the texture rectangle, laid out (u0, v0), (u1, v0), (u1, v1), (u0, v1)
+// around the corners. High z is offset_z + z_units, the far side in -z.
+// Tiled faces repeat the texture along the wall, u1 being its length in tiles.
+struct BoxFace
+{
+	uint8_t corners[4];
+	float normal[3];
+	float uv[4];
+	bool tiled;
+};
 
-	}
+static constexpr uint8_t corner(int x, int y, int z)
+{
+	return (uint8_t)(x | y << 1 | z << 2);
+}
 
-	// -z
+static constexpr BoxFace s_ground_faces[6] = {
+	{},
+	{},
+	{},
+	{ { corner(0, 0, 0), corner(1, 0, 0), corner(1, 0, 1), corner(0, 0, 1) }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 1.0f, 0.0f }, false },
+	{},
+	{},
+};
+
+static constexpr BoxFace s_pillar_faces[6] = {
+	{ { corner(0, 0, 1), corner(0, 0, 0), corner(0, 1, 0), corner(0, 1, 1) }, { -1.0f, 0.0f, 0.0f }, { 0.25f, 13.0f / 17.0f, 0.5f, 0.0f }, false },
+	{ { corner(1, 0, 0), corner(1, 0, 1), corner(1, 1, 1), corner(1, 1, 0) }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 13.0f / 17.0f, 0.25f, 0.0f }, false },
+	{ { corner(0, 0, 1), corner(1, 0, 1), corner(1, 0, 0), corner(0, 0, 0) }, { 0.0f, -1.0f, 0.0f }, { 0.25f, 1.0f, 0.5f, 13.0f / 17.0f }, false },
+	{ { corner(0, 1, 0), corner(1, 1, 0), corner(1, 1, 1), corner(0, 1, 1) }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.25f, 13.0f / 17.0f }, false },
+	{ { corner(1, 0, 1), corner(0, 0, 1), corner(0, 1, 1), corner(1, 1, 1) }, { 0.0f, 0.0f, -1.0f }, { 0.75f, 13.0f / 17.0f, 1.0f, 0.0f }, false },
+	{ { corner(0, 0, 0), corner(1, 0, 0), corner(1, 1, 0), corner(0, 1, 0) }, { 0.0f, 0.0f, 1.0f }, { 0.5f, 13.0f / 17.0f, 0.75f, 0.0f }, false },
+};
+
+// a wall along z, the sides and top tiled
+static constexpr BoxFace s_wall_x_faces[6] = {
+	{ { corner(0, 0, 1), corner(0, 0, 0), corner(0, 1, 0), corner(0, 1, 1) }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 96.0f / 120.0f, 1.0f, 48.0f / 120.0f }, true },
+	{ { corner(1, 0, 0), corner(1, 0, 1), corner(1, 1, 1), corner(1, 1, 0) }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 48.0f / 120.0f, 1.0f, 0.0f }, true },
+	{ { corner(0, 0, 0), corner(0, 0, 1), corner(1, 0, 1), corner(1, 0, 0) }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 1.0f, 108.0f / 120.0f }, true },
+	{ { corner(1, 1, 0), corner(1, 1, 1), corner(0, 1, 1), corner(0, 1, 0) }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 108.0f / 120.0f, 1.0f, 96.0f / 120.0f }, true },
+	{ { corner(1, 0, 1), corner(0, 0, 1), corner(0, 1, 1), corner(1, 1, 1) }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 96.0f / 120.0f, 108.0f / 96.0f, 48.0f / 120.0f }, false },
+	{ { corner(0, 0, 0), corner(1, 0, 0), corner(1, 1, 0), corner(0, 1, 0) }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 48.0f / 120.0f, 108.0f / 96.0f, 0.0f }, false },
+};
+
+// a wall along x, the top, bottom and both sides tiled
+static constexpr BoxFace s_wall_z_faces[6] = {
+	{ { corner(0, 0, 1), corner(0, 0, 0), corner(0, 1, 0), corner(0, 1, 1) }, { -1.0f, 0.0f, 0.0f }, { 1.0f, 96.0f / 120.0f, 108.0f / 96.0f, 48.0f / 120.0f }, false },
+	{ { corner(1, 0, 0), corner(1, 0, 1), corner(1, 1, 1), corner(1, 1, 0) }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 48.0f / 120.0f, 108.0f / 96.0f, 0.0f }, false },
+	{ { corner(0, 0, 1), corner(1, 0, 1), corner(1, 0, 0), corner(0, 0, 0) }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 1.0f, 108.0f / 120.0f }, true },
+	{ { corner(0, 1, 0), corner(1, 1, 0), corner(1, 1, 1), corner(0, 1, 1) }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 108.0f / 120.0f, 1.0f, 96.0f / 120.0f }, true },
+	{ { corner(1, 0, 1), corner(0, 0, 1), corner(0, 1, 1), corner(1, 1, 1) }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 96.0f / 120.0f, 1.0f, 48.0f / 120.0f }, true },
+	{ { corner(0, 0, 0), corner(1, 0, 0), corner(1, 1, 0), corner(0, 1, 0) }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 48.0f / 120.0f, 1.0f, 0.0f }, true },
+};
+
+// faces by number of bits set in their mask
+static const uint8_t s_face_count[64] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+};
+
+// the faces lying on the high side of their axis
+static const bool s_high_face[6] = { false, true, false, true, true, false };
+
+static void generate_box(Geometry& geo, const BoxFace* table, int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask, float tiles)
+{
+	face_mask &= Geometry::FACE_ALL;
+	int num_faces = s_face_count[face_mask];
+
+	// written in place, the vectors grow once per box
+	size_t first = geo.positions.size();
+	size_t first_face = geo.faces.size();
+	geo.positions.resize(first + num_faces * 4);
+	geo.normals.resize(first + num_faces * 4);
+	geo.texcoords.resize(first + num_faces * 4);
+	geo.faces.resize(first_face + num_faces * 2);
+	glm::vec3* position = geo.positions.data() + first;
+	glm::vec3* normal = geo.normals.data() + first;
+	glm::vec2* texcoord = geo.texcoords.data() + first;
+	glm::ivec3* face_out = geo.faces.data() + first_face;
+
+	// The high side is the low side plus the size, except on the face lying there,
+	// which takes it straight from the offsets. Both agree but for the sign of zero.
+	float side[2][3];
+	side[0][0] = (float)offset_x * Geometry::unit;
+	side[0][1] = (float)offset_y * Geometry::unit;
+	side[0][2] = -(float)offset_z * Geometry::unit;
+	side[1][0] = side[0][0] + x_units * Geometry::unit;
+	side[1][1] = side[0][1] + y_units * Geometry::unit;
+	side[1][2] = side[0][2] - z_units * Geometry::unit;
+	float high_face[3] = { (float)(offset_x + x_units) * Geometry::unit, (float)(offset_y + y_units) * Geometry::unit, -(float)(offset_z + z_units) * Geometry::unit };
+
+	int idx = (int)first;
+	for (unsigned bits = face_mask; bits != 0; bits &= bits - 1)
 	{
-		int idx = (int)positions.size();
-
-		float z = -(float)(offset_z + z_units) * unit;
-		float x1 = (float)offset_x * unit;
-		float x0 = x1 + x_units * unit;
-
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 96.0f / 120.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 48.0f / 120.0f;
-
-		glm::vec3 norm = { 0.0f, 0.0f, -1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
-
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
-
+		int f = 0;
+		while ((bits & (1u << f)) == 0) f++;
+		const BoxFace& face = table[f];
+
+		int axis = f >> 1;
+		float high = side[1][axis];
+		if (s_high_face[f]) side[1][axis] = high_face[axis];
+
+		float u1 = face.tiled ? tiles : face.uv[2];
+		float u[4] = { face.uv[0], u1, u1, face.uv[0] };
+		float v[4] = { face.uv[1], face.uv[1], face.uv[3], face.uv[3] };
+		glm::vec3 norm = { face.normal[0], face.normal[1], face.normal[2] };
+		for (int k = 0; k < 4; k++)
+		{
+			int c = face.corners[k];
+			position[k] = { side[c & 1][0], side[(c >> 1) & 1][1], side[c >> 2][2] };
+			normal[k] = norm;
+			texcoord[k] = { u[k], v[k] };
+		}
+		side[1][axis] = high;
+
+		face_out[0] = { idx + 0, idx + 1, idx + 3 };
+		face_out[1] = { idx + 1, idx + 2, idx + 3 };
+		position += 4;
+		normal += 4;
+		texcoord += 4;
+		face_out += 2;
+		idx += 4;
 	}
+}
 
-	// z
-	{
-		int idx = (int)positions.size();
-
-		float z = -(float)offset_z * unit;
-		float x0 = (float)offset_x * unit;
-		float x1 = x0 + x_units * unit;
-		float y0 = (float)offset_y * unit;
-		float y1 = y0 + y_units * unit;
-
-		float u0 = 0.0f;
-		float v0 = 48.0f / 120.0f;
-		float u1 = 96.0f / 108.0f;
-		float v1 = 0.0f;
-
-		glm::vec3 norm = { 0.0f, 0.0f, 1.0f };
-
-		positions.push_back({ x0, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v0 });
-
-		positions.push_back({ x1, y0, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v0 });
-
-		positions.push_back({ x1, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u1, v1 });
-
-		positions.push_back({ x0, y1, z });
-		normals.push_back(norm);
-		texcoords.push_back({ u0, v1 });
+void Geometry::generate_ground(int x_units, int z_units, int offset_x, int offset_y, int offset_z)
+{
+	generate_box(*this, s_ground_faces, x_units, 0, z_units, offset_x, offset_y, offset_z, FACE_POS_Y, 1.0f);
+}
 
-		faces.push_back({ idx + 0, idx + 1, idx + 3 });
-		faces.push_back({ idx + 1, idx + 2, idx + 3 });
+void Geometry::generate_pillar(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask)
+{
+	generate_box(*this, s_pillar_faces, x_units, y_units, z_units, offset_x, offset_y, offset_z, face_mask, 1.0f);
+}
 
-	}
+// the texture repeats along a wall, once per 48 units
+void Geometry::generate_wall_x(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask)
+{
+	generate_box(*this, s_wall_x_faces, x_units, y_units, z_units, offset_x, offset_y, offset_z, face_mask, (float)z_units / 48.0f);
+}
 
-}
\ No newline at end of file
+void Geometry::generate_wall_z(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask)
+{
+	generate_box(*this, s_wall_z_faces, x_units, y_units, z_units, offset_x, offset_y, offset_z, face_mask, (float)x_units / 48.0f);
+}
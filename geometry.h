@@ -1,31 +1,143 @@
 #pragma once
 
+#include <cfloat>
 #include <vector>
 #include <glm.hpp>
 
+#include "spool_file.h"
+
 namespace tinygltf
 {
 	class Model;
 	struct Primitive;
 }
 
+class Geometry;
+
+// Counts and bounds of a geometry, all the layout of its glTF primitive depends on
+struct GeometryStats
+{
+	size_t num_vertices = 0;
+	size_t num_faces = 0;
+	glm::vec3 min_pos = { FLT_MAX, FLT_MAX, FLT_MAX };
+	glm::vec3 max_pos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	// the largest texcoords, at least 1
+	glm::vec2 max_uv = { 1.0f, 1.0f };
+
+	void add(const Geometry& geo);
+
+	// the smallest whole uv_scale bringing every texcoord within 0..1
+	glm::vec2 uv_scale() const;
+};
+
+// Where the data of the buffer views goes, in the order they were laid out:
+// the end of a model's buffer, or a glb file. Views start on 4 bytes.
+class GltfSink
+{
+public:
+	GltfSink(size_t offset = 0) : m_offset(offset) {}
+	virtual ~GltfSink() {}
+
+	bool write(const void* data, size_t length)
+	{
+		m_offset += length;
+		return put(data, length);
+	}
+
+	// zeros up to the next multiple of 4 bytes
+	bool align();
+
+	size_t offset() const { return m_offset; }
+
+protected:
+	virtual bool put(const void* data, size_t length) = 0;
+
+private:
+	size_t m_offset;
+};
+
+class GltfBufferSink : public GltfSink
+{
+public:
+	GltfBufferSink(std::vector<unsigned char>& data) : GltfSink(data.size()), m_data(data) {}
+
+protected:
+	bool put(const void* data, size_t length) override;
+
+private:
+	std::vector<unsigned char>& m_data;
+};
+
 class Geometry
 {
 public:
 	static const float unit;
 
+	// faces of a box, for the generators to leave out hidden ones
+	enum Face
+	{
+		FACE_NEG_X = 1,
+		FACE_POS_X = 2,
+		FACE_NEG_Y = 4,
+		FACE_POS_Y = 8,
+		FACE_NEG_Z = 16,
+		FACE_POS_Z = 32,
+		FACE_ALL = 63,
+	};
+
 	std::vector<glm::ivec3> faces;
 
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;	
 	std::vector<glm::vec2> texcoords;
 
-	void to_gltf(tinygltf::Model& m_out, tinygltf::Primitive& prim_out);
+	// room for this many more vertices and triangles, so the generators do not reallocate
+	void reserve(size_t num_vertices, size_t num_faces);
+
+	GeometryStats stats() const;
+
+	// Appends the buffer views and accessors of a primitive with these stats to the
+	// model, from offset on in buffer 0, without their data. Returns the offset past them.
+	// Quantized, for KHR_mesh_quantization: positions are int16 in units, for a node
+	// scaled by unit, normals normalized int8, and texcoords normalized uint16 of
+	// texcoords / stats.uv_scale(), for a texture transform scaling them back.
+	// Indices are uint16 below 65536 vertices. Positions out of int16 range are
+	// written as floats, still in units.
+	static size_t gltf_layout(tinygltf::Model& m_out, tinygltf::Primitive& prim_out, const GeometryStats& stats, bool quantized, size_t offset);
+
+	// the data of the views gltf_layout laid out for stats()
+	bool write_gltf(GltfSink& sink, const GeometryStats& stats, bool quantized) const;
+
+	// both, at the end of the model's buffer
+	void to_gltf(tinygltf::Model& m_out, tinygltf::Primitive& prim_out, bool quantized = false) const;
 
 	void generate_ground(int x_units, int z_units, int offset_x, int offset_y, int offset_z);
-	void generate_pillar(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z);
-	void generate_wall_x(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z);
-	void generate_wall_z(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z);
+	void generate_pillar(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask = FACE_ALL);
+	void generate_wall_x(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask = FACE_ALL);
+	void generate_wall_z(int x_units, int y_units, int z_units, int offset_x, int offset_y, int offset_z, unsigned face_mask = FACE_ALL);
 };
 
+// A geometry moved out to temporary files as it grows, so a mesh larger than
+// memory can still be written: its views are encoded as they are read back.
+class GeometrySpool
+{
+public:
+	// Moves the pieces of the geometry to the files, their faces shifted past the
+	// vertices already there, and leaves it empty with its capacity.
+	void append(Geometry& geo);
+
+	const GeometryStats& stats() const { return m_stats; }
+
+	bool ok() const { return m_faces.ok() && m_positions.ok() && m_normals.ok() && m_texcoords.ok(); }
 
+	// the data of the views gltf_layout laid out for stats()
+	bool write_gltf(GltfSink& sink, bool quantized);
+
+private:
+	SpoolFile m_faces;
+	SpoolFile m_positions;
+	SpoolFile m_normals;
+	SpoolFile m_texcoords;
+	GeometryStats m_stats;
+};
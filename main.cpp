@@ -1,284 +1,322 @@
-#include <ctime>
+#include <cstdint>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <string>
-#include <glm.hpp>
-
-#define TINYGLTF_NO_STB_IMAGE
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#include <tiny_gltf.h>
 
 #include "maze.h"
-#include "geometry.h"
+#include "maze_model.h"
+#include "batch.h"
+#include "thread_pool.h"
 
 
-int main()
+static void print_usage()
 {
-	srand(time(nullptr));
-
-	int maze_w = 21;
-	int maze_h = 21;
-	Maze maze(maze_w, maze_h);
-	std::vector<Maze::CellLocation> farthests;
-	maze.analyze(farthests);
+	printf("usage: create [-w width] [-h height] [-a algorithm] [-s seed] [-t tile_size] [-j threads] [-o output] [--stream] [--batch count]\n");
+	printf("             [--solution min:max] [--dead-ends min:max] [--corridor min:max] [--farthest] [--goal x,y]... [--no-lone-pillars] [--instanced] [--quantized]\n");
+	printf("algorithms: kruskal, backtracker, wilson, prim, growing_tree, hunt_and_kill, eller\n");
+	printf("-t: generates tiles of tile_size cells on a side concurrently\n");
+	printf("-j: threads used for tiles and batches, all hardware threads by default\n");
+	printf("--batch: writes count mazes named after the output, <output>_<i>.glb, and prints their records as json\n");
+	printf("--stream: meshes the rows of Eller's algorithm as they are generated, skipping analysis.\n");
+	printf("    Only a row is kept in memory; the mesh is spooled to temporary files until written.\n");
+	printf("    A glb holds at most 4 GB: about 3.5 million cells, or 80 million with --instanced\n");
+	printf("    Always Eller's algorithm, -a is rejected\n");
+	printf("--solution, --dead-ends, --corridor: only accept mazes whose solution length, dead end count\n");
+	printf("    or longest straight corridor is in range, either bound may be left out\n");
+	printf("--farthest: start points are the 6 cells farthest from the goal, instead of 6 cells\n");
+	printf("    at one distance from the goal spread as far apart as the maze allows\n");
+	printf("--goal: an exit, may be repeated; start points are placed against the nearest one.\n");
+	printf("    The bottom right corner is the goal if none is given\n");
+	printf("--no-lone-pillars: leaves out the pillars no wall touches\n");
+	printf("--instanced: one prototype per piece placed by EXT_mesh_gpu_instancing\n");
+	printf("--quantized: 16 and 8 bit vertex attributes and indices, KHR_mesh_quantization\n");
+}
 
-	for (size_t i = 0; i < farthests.size(); i++)
+static void print_metrics(const MazeMetrics& metrics)
+{
+	printf("solution length: %d (%d cells), max branch depth: %d\n", metrics.solution_length, metrics.solution_cells, metrics.max_branch_depth);
+	printf("dead ends: %d, junctions: %d, longest corridor: %d\n", metrics.dead_ends, metrics.junctions, metrics.longest_corridor);
+	printf("rivers:");
+	for (int i = 0; i < metrics.river_buckets(); i++)
 	{
-		printf("%d %d\n", farthests[i].x, farthests[i].y);
+		printf(" %d-%d: %d", 1 << i, (2 << i) - 1, metrics.rivers[i]);
 	}
+	printf("\n");
+}
 
-	tinygltf::Model m_out;
-	m_out.scenes.resize(1);
-	tinygltf::Scene& scene_out = m_out.scenes[0];
-	scene_out.name = "Scene";
-
-	m_out.asset.version = "2.0";
-	m_out.asset.generator = "tinygltf";
-
-	m_out.buffers.resize(1);
-	tinygltf::Buffer& buf_out = m_out.buffers[0];
-
-	size_t offset = 0;
-	size_t length = 0;
-	size_t view_id = 0;
-	size_t acc_id = 0;
-
-	// sampler
-	m_out.samplers.resize(1);
-	tinygltf::Sampler& sampler = m_out.samplers[0];
-	sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
-	sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
-
-	// texture
-	struct TexInfo
+// "min:max", "min:" or ":max"
+static void parse_range(const char* value, MetricRange& range)
+{
+	const char* colon = strchr(value, ':');
+	if (colon == nullptr)
 	{
-		std::string path;
-		int width;
-		int height;
-	};
+		range.min = range.max = atoi(value);
+		return;
+	}
+	if (colon > value) range.min = atoi(value);
+	if (colon[1] != 0) range.max = atoi(colon + 1);
+}
 
-	TexInfo tex_info[3] = {
+int main(int argc, char* argv[])
+{
+	int maze_w = 21;
+	int maze_h = 21;
+	MazeAlgorithm algorithm = MazeAlgorithm::Kruskal;
+	std::string output = "maze.glb";
+	bool stream = false;
+	bool algorithm_set = false;
+	uint64_t seed = Random::random_seed();
+	int tile_size = 0;
+	int num_threads = 0;
+	int batch = 0;
+	DifficultyTarget difficulty;
+	bool fair_starts = true;
+	MeshOptions mesh;
+	std::vector<Maze::CellLocation> goals;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		if (strcmp(arg, "--stream") == 0)
 		{
-			"textures/ground.jpg",
-			1024, 1024
-		},		
+			stream = true;
+			continue;
+		}
+		if (strcmp(arg, "--farthest") == 0)
 		{
-			"textures/pillar.jpg",
-			964, 1024
-		},		
+			fair_starts = false;
+			continue;
+		}
+		if (strcmp(arg, "--no-lone-pillars") == 0)
 		{
-			"textures/wall.jpg",
-			922, 1024
-		},		
-	};
-
-	m_out.images.resize(3);
-	m_out.textures.resize(3);
-	
-	for (int i=0;i<3;i++)
-	{
-		TexInfo& info = tex_info[i];
-		tinygltf::Image& img_out = m_out.images[i];
-		tinygltf::Texture& tex_out = m_out.textures[i];
-		img_out.width = info.width;
-		img_out.height = info.height;
-		img_out.component = 4;
-		img_out.bits = 8;
-		img_out.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-		
-		/*img_out.mimeType = "image/jpeg";
+			mesh.lone_pillars = false;
+			continue;
+		}
+		if (strcmp(arg, "--instanced") == 0)
 		{
-			FILE* fp = fopen(info.path.c_str(), "rb");
-			fseek(fp, 0, SEEK_END);
-			size_t len = (size_t)ftell(fp);
-			fseek(fp, 0, SEEK_SET);
-			offset = buf_out.data.size();
-			length = (len + 3) / 4 * 4;
-			buf_out.data.resize(offset + length);
-			fread(buf_out.data.data() + offset, 1, length, fp);
-			fclose(fp);
+			mesh.instanced = true;
+			continue;
 		}
-
-		view_id = m_out.bufferViews.size();
+		if (strcmp(arg, "--quantized") == 0)
 		{
-			tinygltf::BufferView view;
-			view.buffer = 0;
-			view.byteOffset = offset;
-			view.byteLength = length;
-			m_out.bufferViews.push_back(view);
+			mesh.quantized = true;
+			continue;
 		}
-		img_out.bufferView = view_id;*/
-
-		img_out.uri = info.path;
 
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (value == nullptr)
+		{
+			print_usage();
+			return 1;
+		}
 
-		tex_out.sampler = 0;
-		tex_out.source = i;
+		if (strcmp(arg, "-w") == 0)
+		{
+			maze_w = atoi(value);
+		}
+		else if (strcmp(arg, "-h") == 0)
+		{
+			maze_h = atoi(value);
+		}
+		else if (strcmp(arg, "-a") == 0)
+		{
+			if (!parse_algorithm(value, algorithm))
+			{
+				printf("unknown algorithm: %s\n", value);
+				print_usage();
+				return 1;
+			}
+			algorithm_set = true;
+		}
+		else if (strcmp(arg, "-s") == 0)
+		{
+			seed = strtoull(value, nullptr, 10);
+		}
+		else if (strcmp(arg, "-t") == 0)
+		{
+			tile_size = atoi(value);
+		}
+		else if (strcmp(arg, "-j") == 0)
+		{
+			num_threads = atoi(value);
+		}
+		else if (strcmp(arg, "--batch") == 0)
+		{
+			batch = atoi(value);
+		}
+		else if (strcmp(arg, "--solution") == 0)
+		{
+			parse_range(value, difficulty.solution_length);
+		}
+		else if (strcmp(arg, "--dead-ends") == 0)
+		{
+			parse_range(value, difficulty.dead_ends);
+		}
+		else if (strcmp(arg, "--corridor") == 0)
+		{
+			parse_range(value, difficulty.longest_corridor);
+		}
+		else if (strcmp(arg, "--goal") == 0)
+		{
+			Maze::CellLocation goal = { -1, -1 };
+			if (sscanf(value, "%d,%d", &goal.x, &goal.y) != 2)
+			{
+				print_usage();
+				return 1;
+			}
+			goals.push_back(goal);
+		}
+		else if (strcmp(arg, "-o") == 0)
+		{
+			output = value;
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+		i++;
 	}
 
-	// material
-	m_out.materials.resize(3);
-	{
-		tinygltf::Material& material_out = m_out.materials[0];
-		material_out.name = "ground";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 0;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.2;
-		material_out.pbrMetallicRoughness.roughnessFactor = 0.1;		
-	}
+	// the addon's rule, so any maze it makes can be made here too
+	if (maze_w < 1 || maze_h < 1 || (int64_t)maze_w * maze_h < 2)
 	{
-		tinygltf::Material& material_out = m_out.materials[1];
-		material_out.name = "pillar";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 1;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
-		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;		
+		printf("maze must have at least 2 cells\n");
+		return 1;
 	}
+	for (const Maze::CellLocation& goal : goals)
 	{
-		tinygltf::Material& material_out = m_out.materials[2];
-		material_out.name = "wall";
-		material_out.pbrMetallicRoughness.baseColorTexture.index = 2;
-		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
-		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;		
-	}
-
-	// node
-	m_out.nodes.resize(1);
-	tinygltf::Node& node_out = m_out.nodes[0];
-	scene_out.nodes.push_back(0);
-
-	// mesh
-	m_out.meshes.resize(1);
-	tinygltf::Mesh& mesh_out = m_out.meshes[0];
-	node_out.mesh = 0;
-
-	// ground
-	int origin_x = -maze_w * 48 / 2;
-	int origin_y = -maze_h * 48 / 2;
-	for (int y = 0; y < maze_h; y++)
-	{
-		for (int x = 0; x < maze_w; x++)
+		if (goal.x < 0 || goal.x >= maze_w || goal.y < 0 || goal.y >= maze_h)
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 0;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-			Geometry ground;
-			ground.generate_ground(48, 48, origin_x + x * 48, 0, origin_y + y * 48);
-			ground.to_gltf(m_out, prim_out);
-			mesh_out.primitives.emplace_back(prim_out);
+			printf("goal %d,%d is outside the maze\n", goal.x, goal.y);
+			return 1;
 		}
 	}
 
-	// pillars
-	for (int y = 0; y < maze_h + 1; y++)
+	if (stream && algorithm_set)
 	{
-		for (int x = 0; x < maze_w + 1; x++)
-		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 1;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-			Geometry wall;
-			wall.generate_pillar(8, 26, 8, origin_x + x * 48 - 4, 0, origin_y + y * 48 - 4);
-			wall.to_gltf(m_out, prim_out);
-			mesh_out.primitives.emplace_back(prim_out);
-		}
+		printf("--stream always uses Eller's algorithm, -a cannot be given with it\n");
+		return 1;
 	}
 
-	// outer walls
-	for (int x = 0; x < maze_w; x++)
+	if (stream)
 	{
+		printf("seed: %llu\n", (unsigned long long)seed);
+
+		// rows go straight from the generator into the model, and from there to
+		// temporary files, neither the grid nor the mesh is ever stored whole
+		MazeModel model(maze_w, maze_h, mesh);
+		model.spool();
+		EllerGenerator rows(maze_w, maze_h, seed);
+		std::vector<bool> x_walls;
+		std::vector<bool> y_walls;
+		while (rows.next_row(x_walls, y_walls))
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-
-			Geometry wall;
-			wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y - 3);
-			wall.to_gltf(m_out, prim_out);
-
-			mesh_out.primitives.emplace_back(prim_out);
+			model.add_row(rows.row() - 1, x_walls, y_walls);
 		}
-
+		if (!model.save(output))
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-
-			Geometry wall;
-			wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y + maze_h * 48 - 3);
-			wall.to_gltf(m_out, prim_out);
-
-			mesh_out.primitives.emplace_back(prim_out);
+			printf("failed to write %s: out of disk space, or over the 4 GB a glb holds\n", output.c_str());
+			return 1;
 		}
+		return 0;
 	}
 
-	for (int y = 0; y < maze_h; y++)
+	// the main thread works too
+	if (num_threads <= 0) num_threads = ThreadPool::hardware_threads();
+	std::unique_ptr<ThreadPool> pool;
+	if (num_threads > 1) pool.reset(new ThreadPool(num_threads - 1));
+
+	MazeRequest request;
+	request.width = maze_w;
+	request.height = maze_h;
+	request.algorithm = algorithm;
+	request.seed = seed;
+	request.tile_size = tile_size;
+	request.difficulty = difficulty;
+	request.fair_starts = fair_starts;
+	request.goals = goals;
+	request.mesh = mesh;
+	request.path = output;
+
+	if (batch > 0)
 	{
+		std::string stem = output;
+		if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".glb") == 0)
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-
-			Geometry wall;
-			wall.generate_wall_x(6, 24, 48, origin_x - 3, 0, origin_y + y * 48);
-			wall.to_gltf(m_out, prim_out);
-
-			mesh_out.primitives.emplace_back(prim_out);
+			stem.resize(stem.size() - 4);
 		}
 
+		Random seeds(seed);
+		std::vector<MazeRequest> requests(batch, request);
+		for (int i = 0; i < batch; i++)
 		{
-			tinygltf::Primitive prim_out;
-			prim_out.material = 2;
-			prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+			requests[i].seed = seeds.next() & Random::max_seed;
+			requests[i].path = stem + "_" + std::to_string(i) + ".glb";
+		}
 
-			Geometry wall;
-			wall.generate_wall_x(6, 24, 48, origin_x + maze_w * 48 - 3, 0, origin_y + y * 48);
-			wall.to_gltf(m_out, prim_out);
+		std::vector<MazeResult> results;
+		build_mazes(requests, pool.get(), results);
 
-			mesh_out.primitives.emplace_back(prim_out);
-		}
-	}
+		// same records as the server's mazes.json, which reads goals to know the exits
+		std::vector<Maze::CellLocation> record_goals = goals;
+		if (record_goals.empty()) record_goals.push_back({ maze_w - 1, maze_h - 1 });
 
-	// maze walls
-	for (int y = 0; y < maze_h; y++)
-	{
-		for (int x = 0; x < maze_w - 1; x++)
+		printf("[\n");
+		for (int i = 0; i < batch; i++)
 		{
-			if (maze.x_walls[x + y * (maze_w - 1)])
+			const MazeResult& result = results[i];
+			printf("{\"maze_id\": %d, \"seed\": %llu, \"file\": \"%s\", \"start_points\": [", i, (unsigned long long)result.seed, requests[i].path.c_str());
+			for (size_t j = 0; j < result.start_points.size(); j++)
 			{
-				tinygltf::Primitive prim_out;
-				prim_out.material = 2;
-				prim_out.mode = TINYGLTF_MODE_TRIANGLES;
-
-				Geometry wall;
-				wall.generate_wall_x(6, 24, 48, origin_x + (x + 1) * 48 - 3, 0, origin_y + y * 48);
-				wall.to_gltf(m_out, prim_out);
-
-				mesh_out.primitives.emplace_back(prim_out);
+				printf("%s{\"x\": %d, \"y\": %d}", j > 0 ? ", " : "", result.start_points[j].x, result.start_points[j].y);
+			}
+			printf("], \"goals\": [");
+			for (size_t j = 0; j < record_goals.size(); j++)
+			{
+				printf("%s{\"x\": %d, \"y\": %d}", j > 0 ? ", " : "", record_goals[j].x, record_goals[j].y);
+			}
+			const MazeMetrics& metrics = result.metrics;
+			printf("], \"metrics\": {\"solution_length\": %d, \"solution_cells\": %d, \"max_branch_depth\": %d, "
+				"\"dead_ends\": %d, \"junctions\": %d, \"longest_corridor\": %d, \"rivers\": [",
+				metrics.solution_length, metrics.solution_cells, metrics.max_branch_depth,
+				metrics.dead_ends, metrics.junctions, metrics.longest_corridor);
+			for (int j = 0; j < metrics.river_buckets(); j++)
+			{
+				printf("%s%d", j > 0 ? ", " : "", metrics.rivers[j]);
+			}
+			printf("]}}%s\n", i < batch - 1 ? "," : "");
+			if (!result.saved)
+			{
+				fprintf(stderr, "failed to write %s\n", requests[i].path.c_str());
 			}
 		}
+		printf("]\n");
+		return 0;
 	}
-	
-	for (int y = 0; y < maze_h - 1; y++)
-	{
-		for (int x = 0; x < maze_w; x++)
-		{
-			if (maze.y_walls[x + y * maze_w])
-			{
-				tinygltf::Primitive prim_out;
-				prim_out.material = 2;
-				prim_out.mode = TINYGLTF_MODE_TRIANGLES;
 
-				Geometry wall;
-				wall.generate_wall_z(48, 24, 6, origin_x + x * 48, 0, origin_y + (y + 1) * 48 - 3);
-				wall.to_gltf(m_out, prim_out);
+	MazeResult result;
+	build_maze(request, pool.get(), result);
 
-				mesh_out.primitives.emplace_back(prim_out);
-			}
-		}
+	// a difficulty target may have picked another seed
+	printf("seed: %llu\n", (unsigned long long)result.seed);
+	print_metrics(result.metrics);
+	if (!result.met_target)
+	{
+		printf("difficulty target not met\n");
 	}
 
+	for (size_t i = 0; i < result.start_points.size(); i++)
+	{
+		printf("%d %d\n", result.start_points[i].x, result.start_points[i].y);
+	}
 
-	tinygltf::TinyGLTF gltf;
-	gltf.WriteGltfSceneToFile(&m_out, "maze.glb", true, true, false, true);
+	if (!result.saved)
+	{
+		printf("failed to write %s\n", output.c_str());
+		return 1;
+	}
 
 	return 0;
 }
@@ -1,109 +1,28 @@
-#include <queue>
 #include <cstdio>
 #include <cstdlib>
 #include "maze.h"
+#include "bitboard_bfs.h"
 
-void Maze::get_cells(const Wall& wall, int& x0, int& y0, int& x1, int& y1)
+Maze::Maze(int w, int h, uint64_t seed, MazeAlgorithm algorithm) : m_width(w), m_height(h), m_seed(seed)
 {
-	if (!wall.dir)
-	{
-		x0 = wall.x;
-		x1 = wall.x + 1;
-		y0 = wall.y;
-		y1 = wall.y;
-	}
-	else
-	{
-		x0 = wall.x;
-		x1 = wall.x;
-		y0 = wall.y;
-		y1 = wall.y + 1;
-	}
+	init_cells();
 
+	Random rng(seed);
+	MazeGenerator::create(algorithm)->generate(*this, rng);
 }
 
-void Maze::get_cell_ids(const std::vector<int>& cell_id, const Wall& wall, int& id0, int& id1)
+Maze::Maze(int w, int h, uint64_t seed, MazeGenerator& generator) : m_width(w), m_height(h), m_seed(seed)
 {
-	int x0, y0, x1, y1;
-	get_cells(wall, x0, y0, x1, y1);
+	init_cells();
 
-	id0 = cell_id[x0 + y0 * m_width];
-	id1 = cell_id[x1 + y1 * m_width];
+	Random rng(seed);
+	generator.generate(*this, rng);
 }
 
-Maze::Maze(int w, int h) : m_width(w), m_height(h)
+void Maze::init_cells()
 {
-	std::vector<int> cell_id(w * h);
-	for (int i = 0; i < w * h; i++)
-	{
-		cell_id[i] = i;
-	}
-
-	x_walls.resize((w - 1) * h, true);
-	y_walls.resize(w * (h - 1), true);
-
-	while (true)
-	{
-		std::vector<Wall> active_walls;
-		for (int y = 0; y < h; y++)
-		{
-			for (int x = 0; x < w - 1; x++)
-			{
-				Wall wall = { false, x,y };
-				int id0, id1;
-				get_cell_ids(cell_id, wall, id0, id1);
-				if (id0 != id1)
-				{
-					active_walls.push_back(wall);
-				}
-			}
-		}
-		for (int y = 0; y < h - 1; y++)
-		{
-			for (int x = 0; x < w; x++)
-			{
-				Wall wall = { true, x,y };
-				int id0, id1;
-				get_cell_ids(cell_id, wall, id0, id1);
-				if (id0 != id1)
-				{
-					active_walls.push_back(wall);
-				}
-			}
-		}
-		if (active_walls.size() < 1) break;
-
-		int num_active_walls = (int)active_walls.size();
-
-		int idx_remove = rand() % num_active_walls;
-		Wall& wall_to_remove = active_walls[idx_remove];
-
-		if (!wall_to_remove.dir)
-		{
-			x_walls[wall_to_remove.x + wall_to_remove.y * (w - 1)] = false;		
-		}
-		else
-		{
-			y_walls[wall_to_remove.x + wall_to_remove.y * w] = false;
-		}
-
-		int id0, id1;
-		get_cell_ids(cell_id, wall_to_remove, id0, id1);		
-		if (id0 > id1)
-		{
-			int tmp = id0;
-			id0 = id1;
-			id1 = tmp;
-		}
-
-		for (int i = 0; i < w * h; i++)
-		{
-			if (cell_id[i] == id1)
-			{
-				cell_id[i] = id0;
-			}
-		}
-	}
+	m_words_per_row = ((size_t)m_width + CELLS_PER_WORD - 1) / CELLS_PER_WORD;
+	m_cells.assign(m_words_per_row * m_height, 0);
 }
 
 void Maze::print()
@@ -124,7 +43,7 @@ void Maze::print()
 		for (int x = 0; x < m_width-1; x++)
 		{
 			printf("  ");
-			if (x_walls[x + y * (m_width - 1)])
+			if (has_x_wall(x, y))
 			{
 				printf("");
 			}
@@ -138,7 +57,7 @@ void Maze::print()
 		printf("");
 		for (int x = 0; x < m_width-1; x++)
 		{			
-			if (y_walls[x + y * m_width])
+			if (has_y_wall(x, y))
 			{
 				printf("");
 			}
@@ -150,7 +69,7 @@ void Maze::print()
 		}
 		{
 			int x = m_width - 1;
-			if (y_walls[x + y * m_width])
+			if (has_y_wall(x, y))
 			{
 				printf("");
 			}
@@ -169,7 +88,7 @@ void Maze::print()
 		for (int x = 0; x < m_width - 1; x++)
 		{
 			printf("  ");
-			if (x_walls[x + y * (m_width - 1)])
+			if (has_x_wall(x, y))
 			{
 				printf("");
 			}
@@ -192,103 +111,198 @@ void Maze::print()
 
 void Maze::analyze(std::vector<CellLocation>& farthests)
 {
-	struct Node
+	analyze(farthests, 6, { m_width - 1, m_height - 1 });
+}
+
+void Maze::push_cell(uint32_t cell)
+{
+	if (m_queue_tail - m_queue_head == m_queue.size())
 	{
-		int x;
-		int y;
-		int steps;
-	};
+		// full: unwrap into a buffer twice the size, only happens while warming up
+		std::vector<uint32_t> queue(m_queue.size() * 2);
+		size_t mask = m_queue.size() - 1;
+		for (size_t i = m_queue_head; i < m_queue_tail; i++)
+		{
+			queue[i - m_queue_head] = m_queue[i & mask];
+		}
+		m_queue_tail -= m_queue_head;
+		m_queue_head = 0;
+		m_queue.swap(queue);
+	}
+	m_queue[m_queue_tail++ & (m_queue.size() - 1)] = cell;
+}
 
-	Node end = { m_width - 1, m_height -1, 0 };
+void Maze::keep_farthest(uint32_t cell, uint32_t steps, int k)
+{
+	size_t cell_mask = m_top_cells.size() - 1;
+	size_t class_mask = m_top_classes.size() - 1;
 
-	std::vector<int> cell_steps(m_width* m_height, 0x7FFFFFFF);
+	// BFS order never goes back to a smaller distance, so a new distance starts a new class
+	if (m_top_class_count == 0 || steps != m_top_steps)
+	{
+		m_top_steps = steps;
+		m_top_classes[(m_top_class_first + m_top_class_count++) & class_mask] = { m_top_cell_tail, 0 };
+	}
 
-	std::queue<Node> queue;
-	queue.push(end);
+	// only the first k cells of a class can ever be reported
+	TopClass& current = m_top_classes[(m_top_class_first + m_top_class_count - 1) & class_mask];
+	if (current.count == (uint32_t)k) return;
+	m_top_cells[m_top_cell_tail++ & cell_mask] = cell;
+	current.count++;
+	m_top_cell_total++;
 
-	std::vector<std::vector<Node>> classes;
-	
-	while (queue.size() > 0)
+	// drop the nearest class once the others hold k cells on their own
+	while (m_top_class_count > 1 && m_top_cell_total - m_top_classes[m_top_class_first & class_mask].count >= (uint32_t)k)
 	{
-		Node node = queue.front();
-		queue.pop();
+		m_top_cell_total -= m_top_classes[m_top_class_first & class_mask].count;
+		m_top_class_first++;
+		m_top_class_count--;
+	}
+}
 
-		if (node.steps >= classes.size())
-		{
-			classes.resize(node.steps + 1);
-		}
-		classes[node.steps].push_back(node);		
+void Maze::analyze(std::vector<CellLocation>& farthests, int k, CellLocation goal)
+{
+	analyze_from(farthests, k, &goal, 1, false);
+}
 
-		if (node.x > 0 && !x_walls[node.x - 1 + node.y * (m_width - 1)])
-		{
-			int s = cell_steps[node.x - 1 + node.y * m_width];
-			if (s > node.steps + 1)
-			{
-				cell_steps[node.x - 1 + node.y * m_width] = node.steps + 1;
-				queue.push({ node.x - 1, node.y, node.steps + 1 });
-			}
-		}
-		
-		if (node.x < m_width - 1 && !x_walls[node.x + node.y * (m_width - 1)])
-		{
-			int s = cell_steps[node.x + 1 +  node.y * m_width];
-			if (s > node.steps + 1)
-			{
-				cell_steps[node.x + 1 + node.y * m_width] = node.steps + 1;
-				queue.push({ node.x + 1, node.y, node.steps + 1 });
-			}
-		}
+void Maze::analyze(std::vector<CellLocation>& farthests, int k, const std::vector<CellLocation>& goals)
+{
+	analyze_from(farthests, k, goals.data(), goals.size(), true);
+}
 
-		if (node.y > 0 && !y_walls[node.x + (node.y - 1) * m_width])
-		{
-			int s = cell_steps[node.x + (node.y-1) * m_width];
-			if (s > node.steps + 1)
-			{
-				cell_steps[node.x + (node.y - 1) * m_width] = node.steps + 1;
-				queue.push({ node.x, node.y-1, node.steps + 1 });
-			}
-		}
-		
-		if (node.y < m_height - 1 && !y_walls[node.x + node.y * m_width])
+void Maze::analyze_from(std::vector<CellLocation>& farthests, int k, const CellLocation* goals, size_t num_goals, bool nearest)
+{
+	farthests.clear();
+	if (k <= 0) return;
+
+	size_t num_cells = (size_t)m_width * m_height;
+	m_steps.assign(num_cells, UNREACHED);
+	if (m_queue.empty())
+	{
+		size_t capacity = 64;
+		while (capacity < (size_t)(m_width + m_height) * 2) capacity <<= 1;
+		m_queue.resize(capacity);
+	}
+	m_queue_head = m_queue_tail = 0;
+
+	// at most 2k - 1 cells in at most k classes are held at once
+	size_t top_capacity = 1;
+	while (top_capacity < (size_t)k * 2) top_capacity <<= 1;
+	if (m_top_cells.size() < top_capacity)
+	{
+		m_top_cells.resize(top_capacity);
+		m_top_classes.resize(top_capacity);
+	}
+	m_top_cell_tail = 0;
+	m_top_cell_total = 0;
+	m_top_class_first = 0;
+	m_top_class_count = 0;
+
+	// all goals start the BFS at distance 0, so each cell is reached from its nearest goal
+	if (nearest) m_nearest.assign(num_cells, UNREACHED);
+	for (size_t i = 0; i < num_goals; i++)
+	{
+		uint32_t start = (uint32_t)(goals[i].x + goals[i].y * m_width);
+		if (m_steps[start] != UNREACHED) continue;
+		m_steps[start] = 0;
+		if (nearest) m_nearest[start] = (uint32_t)i;
+		push_cell(start);
+	}
+
+	int w = m_width;
+	while (m_queue_head < m_queue_tail)
+	{
+		uint32_t cell = m_queue[m_queue_head++ & (m_queue.size() - 1)];
+		uint32_t steps = m_steps[cell];
+		keep_farthest(cell, steps, k);
+
+		auto visit = [&](uint32_t next)
 		{
+			m_steps[next] = steps + 1;
+			if (nearest) m_nearest[next] = m_nearest[cell];
+			push_cell(next);
+		};
 
-			int s = cell_steps[node.x + (node.y + 1) * m_width];
-			if (s > node.steps + 1)
-			{
-				cell_steps[node.x + (node.y + 1) * m_width] = node.steps + 1;
-				queue.push({ node.x, node.y + 1, node.steps + 1 });
-			}
-		}
+		unsigned dirs = open_dirs((int)(cell % w), (int)(cell / w));
+		if ((dirs & OPEN_NEG_X) && m_steps[cell - 1] == UNREACHED) visit(cell - 1);
+		if ((dirs & OPEN_POS_X) && m_steps[cell + 1] == UNREACHED) visit(cell + 1);
+		if ((dirs & OPEN_NEG_Y) && m_steps[cell - w] == UNREACHED) visit(cell - w);
+		if ((dirs & OPEN_POS_Y) && m_steps[cell + w] == UNREACHED) visit(cell + w);
 	}
 
-	/*int count = 0;
-	for (size_t i = 0; i < classes.size(); i++)
+	// farthest class first, BFS order within a class
+	if (farthests.capacity() < (size_t)k) farthests.reserve(k);
+	size_t cell_mask = m_top_cells.size() - 1;
+	size_t class_mask = m_top_classes.size() - 1;
+	for (size_t c = m_top_class_count; c-- > 0 && farthests.size() < (size_t)k;)
 	{
-		printf("%d %d\n", i, classes[i].size());
-		auto& cls = classes[i];
-		printf("[");
-		for (size_t j = 0; j < cls.size(); j++)
+		const TopClass& cls = m_top_classes[(m_top_class_first + c) & class_mask];
+		for (uint32_t j = 0; j < cls.count && farthests.size() < (size_t)k; j++)
 		{
-			Node& node = cls[j];
-			printf("[%d, %d], ", node.x, node.y);
+			uint32_t cell = m_top_cells[(cls.first + j) & cell_mask];
+			farthests.push_back({ (int)(cell % w), (int)(cell / w) });
 		}
-		printf("]\n");		
-
-		count += classes[i].size();
 	}
-	printf("total: %d\n", count);*/
+}
 
-	farthests.clear();
-	for (size_t i = classes.size()-1; i != (size_t)(-1); i--)
+int Maze::solve(CellLocation from, std::vector<uint8_t>& moves) const
+{
+	moves.clear();
+	if (m_steps.empty()) return -1;
+
+	int w = m_width;
+	size_t cell = (size_t)from.x + (size_t)from.y * w;
+	uint32_t steps = m_steps[cell];
+	if (steps == UNREACHED) return -1;
+
+	// Every step goes to the open neighbor one nearer the goal. The side just come
+	// through leads back one farther, so with one other open side that is the way
+	// and its distance need not be looked at.
+	static const int first_dir[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+	// a step moves the cell index and the cell's bit in m_cells by a fixed amount
+	const ptrdiff_t cell_step[4] = { -1, 1, -(ptrdiff_t)w, (ptrdiff_t)w };
+	const ptrdiff_t bit_step[4] = { -4, 4, -(ptrdiff_t)(m_words_per_row << 6), (ptrdiff_t)(m_words_per_row << 6) };
+
+	// locals only, stores to the uint8_t moves could alias any member
+	const uint64_t* cells = m_cells.data();
+	const uint32_t* distances = m_steps.data();
+
+	moves.resize((steps + 3) / 4);
+	uint8_t* out = moves.data();
+	size_t bit = cell_bit(from.x, from.y);
+	unsigned back = 0;
+	unsigned packed = 0;
+	for (uint32_t i = 0; i < steps; i++)
 	{
-		auto& cls = classes[i];
-		for (size_t j = 0; j < cls.size(); j++)
+		unsigned dirs = (unsigned)(cells[bit >> 6] >> (bit & 63)) & 0xF & ~back;
+		int dir = first_dir[dirs];
+		if ((dirs & (dirs - 1)) != 0)
+		{
+			uint32_t next = steps - i - 1;
+			if ((dirs & OPEN_NEG_X) && distances[cell - 1] == next) dir = DIR_NEG_X;
+			else if ((dirs & OPEN_POS_X) && distances[cell + 1] == next) dir = DIR_POS_X;
+			else if ((dirs & OPEN_NEG_Y) && distances[cell - w] == next) dir = DIR_NEG_Y;
+			else dir = DIR_POS_Y;
+		}
+
+		cell += cell_step[dir];
+		bit += bit_step[dir];
+		back = 1u << (dir ^ 1);
+		packed |= (unsigned)dir << ((i & 3) * 2);
+		if ((i & 3) == 3)
 		{
-			Node& node = cls[j];
-			farthests.push_back({ node.x, node.y });
-			if (farthests.size() == 6) break;
+			out[i >> 2] = (uint8_t)packed;
+			packed = 0;
 		}
-		if (farthests.size() == 6) break;
 	}
+	if ((steps & 3) != 0) out[steps >> 2] = (uint8_t)packed;
+	return (int)steps;
+}
 
+void Maze::analyze_bitboard(std::vector<CellLocation>& farthests, int k, CellLocation goal)
+{
+	BitboardBFS bfs;
+	bfs.run(*this, goal, m_steps);
+	bfs.farthest(*this, m_steps, k, farthests);
 }
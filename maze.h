@@ -1,17 +1,54 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
+#include "generator.h"
 
 class Maze
 {
 public:
 	int m_width;
 	int m_height;
+	uint64_t m_seed;
 
-	std::vector<bool> x_walls;
-	std::vector<bool> y_walls;
+	// the same seed and algorithm always give the same maze
+	Maze(int w, int h, uint64_t seed, MazeAlgorithm algorithm = MazeAlgorithm::Kruskal);
+	Maze(int w, int h, uint64_t seed, MazeGenerator& generator);
 
-	Maze(int w, int h);
+	// directions out of a cell
+	static const int DIR_NEG_X = 0;
+	static const int DIR_POS_X = 1;
+	static const int DIR_NEG_Y = 2;
+	static const int DIR_POS_Y = 3;
+
+	static const unsigned OPEN_NEG_X = 1 << DIR_NEG_X;
+	static const unsigned OPEN_POS_X = 1 << DIR_POS_X;
+	static const unsigned OPEN_NEG_Y = 1 << DIR_NEG_Y;
+	static const unsigned OPEN_POS_Y = 1 << DIR_POS_Y;
+
+	// open sides of cell (x, y) as a mask of OPEN_* bits
+	unsigned open_dirs(int x, int y) const
+	{
+		size_t bit = cell_bit(x, y);
+		return (unsigned)(m_cells[bit >> 6] >> (bit & 63)) & 0xF;
+	}
+
+	bool is_open(int x, int y, int dir) const { return (open_dirs(x, y) & (1u << dir)) != 0; }
+
+	// wall between (x, y) and (x + 1, y)
+	bool has_x_wall(int x, int y) const { return !is_open(x, y, DIR_POS_X); }
+
+	// wall between (x, y) and (x, y + 1)
+	bool has_y_wall(int x, int y) const { return !is_open(x, y, DIR_POS_Y); }
+
+	// removes the wall on the given side of cell (x, y)
+	void open(int x, int y, int dir)
+	{
+		static const int dx[4] = { -1, 1, 0, 0 };
+		static const int dy[4] = { 0, 0, -1, 1 };
+		set_open(x, y, 1u << dir);
+		set_open(x + dx[dir], y + dy[dir], 1u << (dir ^ 1));
+	}
 
 	struct CellLocation
 	{
@@ -20,16 +57,97 @@ public:
 	};
 
 	void print();
+
+	// Finds the k cells farthest from the goal, farthest first, cells at the same
+	// distance in BFS order. Scratch buffers are kept in the maze, so analyzing it
+	// again allocates nothing.
+	void analyze(std::vector<CellLocation>& farthests, int k, CellLocation goal);
+
+	// the 6 cells farthest from the bottom right corner
 	void analyze(std::vector<CellLocation>& farthests);
 
+	// The same with several goals, in one BFS started from all of them: distances
+	// are to each cell's nearest goal, and the farthest cells are the ones farthest
+	// from every goal. take_nearest_goals tells which goal is the nearest.
+	void analyze(std::vector<CellLocation>& farthests, int k, const std::vector<CellLocation>& goals);
+
+	// Same results as analyze, from a BFS over bit rows (see BitboardBFS).
+	// The maze must be perfect.
+	void analyze_bitboard(std::vector<CellLocation>& farthests, int k, CellLocation goal);
+
+	// distance marking cells the last analysis could not reach
+	static constexpr uint32_t UNREACHED = 0xFFFFFFFF;
+
+	// The path from a cell to its nearest goal of the last analysis, read off its distance
+	// field: 2 bits per step, the DIR_* of each step, 4 steps per byte starting
+	// from the low bits. Returns the number of steps, -1 if the cell was not
+	// reached or the distances were taken.
+	int solve(CellLocation from, std::vector<uint8_t>& moves) const;
+
+	// Hands over the distance of every cell (x + y * m_width) to the goal of the
+	// last analysis, without copying. The next analysis starts a fresh buffer.
+	void take_distances(std::vector<uint32_t>& distances)
+	{
+		distances.swap(m_steps);
+		m_steps.clear();
+	}
+
+	// Hands over the index in goals of every cell's nearest goal, from the last
+	// analysis with a list of goals, UNREACHED if not connected. Cells as far from
+	// two goals go to either.
+	void take_nearest_goals(std::vector<uint32_t>& nearest)
+	{
+		nearest.swap(m_nearest);
+		m_nearest.clear();
+	}
+
+	// 4 bits per cell, each row starting on a fresh word
+	static const int CELLS_PER_WORD = 16;
+
+	// the packed open sides of row y, cell x in bits 4 * (x % 16) of word x / 16
+	const uint64_t* packed_row(int y) const { return m_cells.data() + (size_t)y * m_words_per_row; }
+
 private:
-	struct Wall
+	std::vector<uint64_t> m_cells;
+	size_t m_words_per_row;
+
+	size_t cell_bit(int x, int y) const
+	{
+		return ((size_t)y * m_words_per_row << 6) + ((size_t)x << 2);
+	}
+
+	void set_open(int x, int y, unsigned mask)
+	{
+		size_t bit = cell_bit(x, y);
+		m_cells[bit >> 6] |= (uint64_t)mask << (bit & 63);
+	}
+
+	void init_cells();
+
+	// analysis scratch
+	std::vector<uint32_t> m_steps;
+	std::vector<uint32_t> m_nearest;
+
+	// BFS queue, a ring buffer of power of 2 size
+	std::vector<uint32_t> m_queue;
+	size_t m_queue_head = 0;
+	size_t m_queue_tail = 0;
+
+	// the farthest cells so far, as runs of cells at the same distance in a ring
+	struct TopClass
 	{
-		bool dir = false; // x
-		int x = 0;
-		int y = 0;
+		size_t first;
+		uint32_t count;
 	};
+	std::vector<uint32_t> m_top_cells;
+	std::vector<TopClass> m_top_classes;
+	size_t m_top_cell_tail = 0;
+	uint32_t m_top_cell_total = 0;
+	size_t m_top_class_first = 0;
+	size_t m_top_class_count = 0;
+	uint32_t m_top_steps = 0;
 
-	void get_cells(const Wall& wall, int& x0, int& y0, int& x1, int& y1);
-	void get_cell_ids(const std::vector<int>& cell_id, const Wall& wall, int& id0, int& id1);
+	void analyze_from(std::vector<CellLocation>& farthests, int k, const CellLocation* goals, size_t num_goals, bool nearest);
+	void push_cell(uint32_t cell);
+	void keep_farthest(uint32_t cell, uint32_t steps, int k);
 };
\ No newline at end of file
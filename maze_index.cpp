@@ -0,0 +1,205 @@
+#include "maze_index.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const int dx[4] = { -1, 1, 0, 0 };
+static const int dy[4] = { 0, 0, -1, 1 };
+
+static inline int lowest_bit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static inline int floor_log2(uint32_t value)
+{
+	int log = 0;
+	while (value >>= 1) log++;
+	return log;
+}
+
+MazeIndex::MazeIndex(const Maze& maze) : m_width(maze.m_width), m_height(maze.m_height)
+{
+	uint32_t num_cells = (uint32_t)m_width * m_height;
+	m_depth.resize(num_cells);
+	m_parent.resize(num_cells);
+	m_enter.resize(num_cells);
+	m_exit.resize(num_cells);
+	m_first.resize(num_cells);
+	m_open.resize(num_cells);
+	m_tour.reserve(num_cells * 2 - 1);
+
+	for (int y = 0; y < m_height; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			m_open[x + y * m_width] = (uint8_t)maze.open_dirs(x, y);
+		}
+	}
+
+	// depth first walk from cell 0, the tour lists a cell on entry and again after each child
+	struct Frame
+	{
+		uint32_t cell;
+		int dir;
+	};
+	std::vector<Frame> stack;
+	uint32_t counter = 0;
+
+	m_depth[0] = 0;
+	m_parent[0] = 0;
+	m_enter[0] = counter++;
+	m_first[0] = 0;
+	m_tour.push_back(0);
+	stack.push_back({ 0, 0 });
+
+	while (!stack.empty())
+	{
+		Frame& top = stack.back();
+		uint32_t c = top.cell;
+		if (top.dir < 4)
+		{
+			int dir = top.dir++;
+			if ((m_open[c] & (1u << dir)) == 0) continue;
+			uint32_t next = c + dx[dir] + dy[dir] * m_width;
+			if (next == m_parent[c] && c != 0) continue;
+
+			m_depth[next] = m_depth[c] + 1;
+			m_parent[next] = c;
+			m_enter[next] = counter++;
+			m_first[next] = (uint32_t)m_tour.size();
+			m_tour.push_back(next);
+			stack.push_back({ next, 0 });
+			continue;
+		}
+
+		m_exit[c] = counter - 1;
+		stack.pop_back();
+		if (!stack.empty())
+		{
+			m_tour.push_back(stack.back().cell);
+		}
+	}
+
+	// for every tour entry, the entries of its block up to it that are smaller than
+	// everything after them: the lowest one at or after l is the minimum of [l, i]
+	uint32_t tour_size = (uint32_t)m_tour.size();
+	m_in_block.resize(tour_size);
+	for (uint32_t start = 0; start < tour_size; start += BLOCK_SIZE)
+	{
+		uint64_t mask = 0;
+		uint32_t end = start + BLOCK_SIZE < tour_size ? start + BLOCK_SIZE : tour_size;
+		for (uint32_t i = start; i < end; i++)
+		{
+			while (mask != 0)
+			{
+				int top = 63;
+				while ((mask >> top) == 0) top--;
+				if (tour_depth(start + top) < tour_depth(i)) break;
+				mask &= ~(1ull << top);
+			}
+			mask |= 1ull << (i - start);
+			m_in_block[i] = mask;
+		}
+	}
+
+	uint32_t num_blocks = (tour_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_block_min.resize(floor_log2(num_blocks) + 1);
+	m_block_min[0].resize(num_blocks);
+	for (uint32_t b = 0; b < num_blocks; b++)
+	{
+		uint32_t last = (b + 1) * BLOCK_SIZE - 1 < tour_size ? (b + 1) * BLOCK_SIZE - 1 : tour_size - 1;
+		m_block_min[0][b] = block_range_min(b * BLOCK_SIZE, last);
+	}
+	for (size_t level = 1; level < m_block_min.size(); level++)
+	{
+		uint32_t span = 1u << level;
+		const std::vector<uint32_t>& below = m_block_min[level - 1];
+		std::vector<uint32_t>& mins = m_block_min[level];
+		mins.resize(num_blocks - span + 1);
+		for (uint32_t b = 0; b + span <= num_blocks; b++)
+		{
+			mins[b] = min_index(below[b], below[b + span / 2]);
+		}
+	}
+}
+
+uint32_t MazeIndex::block_range_min(uint32_t l, uint32_t r) const
+{
+	uint32_t start = r - r % BLOCK_SIZE;
+	uint64_t mask = m_in_block[r] & (~0ull << (l - start));
+	return start + lowest_bit(mask);
+}
+
+uint32_t MazeIndex::lca(uint32_t a, uint32_t b) const
+{
+	uint32_t l = m_first[a];
+	uint32_t r = m_first[b];
+	if (l > r)
+	{
+		uint32_t t = l;
+		l = r;
+		r = t;
+	}
+
+	uint32_t bl = l / BLOCK_SIZE;
+	uint32_t br = r / BLOCK_SIZE;
+	if (bl == br) return m_tour[block_range_min(l, r)];
+
+	uint32_t best = min_index(block_range_min(l, bl * BLOCK_SIZE + BLOCK_SIZE - 1), block_range_min(br * BLOCK_SIZE, r));
+	if (br - bl > 1)
+	{
+		int level = floor_log2(br - bl - 1);
+		const std::vector<uint32_t>& mins = m_block_min[level];
+		best = min_index(best, min_index(mins[bl + 1], mins[br - (1u << level)]));
+	}
+	return m_tour[best];
+}
+
+uint32_t MazeIndex::cell_distance(uint32_t a, uint32_t b) const
+{
+	return m_depth[a] + m_depth[b] - 2 * m_depth[lca(a, b)];
+}
+
+int MazeIndex::distance(Maze::CellLocation a, Maze::CellLocation b) const
+{
+	return (int)cell_distance(cell(a), cell(b));
+}
+
+int MazeIndex::path_length_via(Maze::CellLocation a, Maze::CellLocation b, Maze::CellLocation c) const
+{
+	return (int)(cell_distance(cell(a), cell(c)) + cell_distance(cell(c), cell(b)));
+}
+
+bool MazeIndex::next_step(Maze::CellLocation a, Maze::CellLocation b, Maze::CellLocation& next) const
+{
+	uint32_t from = cell(a);
+	uint32_t to = cell(b);
+	if (from == to) return false;
+
+	// up towards the root unless b is below a, then down into the child holding b
+	uint32_t step = m_parent[from];
+	if (is_ancestor(from, to))
+	{
+		for (int dir = 0; dir < 4; dir++)
+		{
+			if ((m_open[from] & (1u << dir)) == 0) continue;
+			uint32_t child = from + dx[dir] + dy[dir] * m_width;
+			if (child != m_parent[from] && is_ancestor(child, to))
+			{
+				step = child;
+				break;
+			}
+		}
+	}
+
+	next = { (int)(step % m_width), (int)(step / m_width) };
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+
+// Constant time path queries on a perfect maze, which is a tree. The tree is
+// rooted at cell (0, 0) and walked once to get depths, parents, entry and exit
+// times and an Euler tour. Lowest common ancestors come from a range minimum
+// over the tour's depths: a sparse table over blocks of 64 tour entries, plus
+// a bit mask per entry for the minimum inside its block. Memory stays linear
+// and every query is O(1).
+class MazeIndex
+{
+public:
+	// the maze must be perfect
+	MazeIndex(const Maze& maze);
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+
+	// steps on the path from a to b, 0 if they are the same cell
+	int distance(Maze::CellLocation a, Maze::CellLocation b) const;
+
+	// steps of the shortest walk from a to b that passes through c
+	int path_length_via(Maze::CellLocation a, Maze::CellLocation b, Maze::CellLocation c) const;
+
+	// The cell after a on the path from a to b. Returns false if a and b are the same cell.
+	bool next_step(Maze::CellLocation a, Maze::CellLocation b, Maze::CellLocation& next) const;
+
+private:
+	static const int BLOCK_SIZE = 64;
+
+	int m_width;
+	int m_height;
+
+	// per cell
+	std::vector<uint32_t> m_depth;
+	std::vector<uint32_t> m_parent;
+	std::vector<uint32_t> m_enter;
+	std::vector<uint32_t> m_exit;
+	std::vector<uint32_t> m_first;
+	std::vector<uint8_t> m_open;
+
+	// per Euler tour entry
+	std::vector<uint32_t> m_tour;
+	std::vector<uint64_t> m_in_block;
+
+	// m_block_min[level][b]: tour index of the minimum over blocks [b, b + 2^level)
+	std::vector<std::vector<uint32_t>> m_block_min;
+
+	uint32_t cell(Maze::CellLocation loc) const { return (uint32_t)(loc.x + loc.y * m_width); }
+	uint32_t tour_depth(uint32_t i) const { return m_depth[m_tour[i]]; }
+	uint32_t min_index(uint32_t i, uint32_t j) const { return tour_depth(j) < tour_depth(i) ? j : i; }
+
+	// minimum tour index over [l, r], both in the same block
+	uint32_t block_range_min(uint32_t l, uint32_t r) const;
+
+	uint32_t lca(uint32_t a, uint32_t b) const;
+	bool is_ancestor(uint32_t a, uint32_t b) const { return m_enter[a] <= m_enter[b] && m_exit[b] <= m_exit[a]; }
+	uint32_t cell_distance(uint32_t a, uint32_t b) const;
+};
@@ -0,0 +1,59 @@
+#include "maze_metrics.h"
+
+void MetricsKernel::pop()
+{
+	const Frame& frame = m_stack[--m_depth];
+	MazeMetrics& metrics = *m_metrics;
+
+	// a straight run is counted at its cell nearest the goal, where it was not entered along its axis
+	for (int axis = 0; axis < 2; axis++)
+	{
+		int neg = axis * 2;
+		int pos = axis * 2 + 1;
+		if (frame.dir_in == neg || frame.dir_in == pos) continue;
+		int run = (int)(1 + frame.straight[neg] + frame.straight[pos]);
+		if (run > metrics.longest_corridor) metrics.longest_corridor = run;
+	}
+
+	uint32_t river = frame.degree == 2 ? 1 + frame.river : 0;
+	uint32_t branch = frame.path_branch > frame.side ? frame.path_branch : frame.side;
+
+	if (m_depth == 0)
+	{
+		if (river > 0) add_river(river);
+		metrics.solution_length = (int)frame.height;
+		metrics.max_branch_depth = (int)branch;
+		return;
+	}
+
+	Frame& parent = m_stack[m_depth - 1];
+	if (river > 0)
+	{
+		// a river ends where it reaches a junction or a dead end
+		if (parent.degree == 2) parent.river += river;
+		else add_river(river);
+	}
+
+	parent.straight[frame.dir_in] = 1 + frame.straight[frame.dir_in];
+
+	// the path to the farthest cell goes through the tallest child, the others branch off it
+	uint32_t reach = frame.height + 1;
+	if (reach > parent.height)
+	{
+		if (parent.height > parent.side) parent.side = parent.height;
+		parent.height = reach;
+		parent.path_branch = branch;
+	}
+	else if (reach > parent.side)
+	{
+		parent.side = reach;
+	}
+}
+
+void MetricsKernel::add_river(uint32_t length)
+{
+	int bucket = 0;
+	while (length >>= 1) bucket++;
+	if (bucket >= MazeMetrics::RIVER_BUCKETS) bucket = MazeMetrics::RIVER_BUCKETS - 1;
+	m_metrics->rivers[bucket]++;
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+
+// What makes a maze hard to play
+struct MazeMetrics
+{
+	// steps from the farthest cell to its nearest goal, the bottom right corner by default
+	int solution_length = 0;
+
+	// cells on that path, both ends included
+	int solution_cells = 0;
+
+	// farthest any cell lies from the solution path
+	int max_branch_depth = 0;
+
+	// cells with a single open side
+	int dead_ends = 0;
+
+	// cells with three or more open sides
+	int junctions = 0;
+
+	// longest straight run of connected cells, in cells
+	int longest_corridor = 0;
+
+	// Rivers are the passages between junctions and dead ends, runs of cells with
+	// exactly two open sides. Bucket i counts rivers of [2^i, 2^(i+1)) cells.
+	static const int RIVER_BUCKETS = 32;
+	std::array<int, RIVER_BUCKETS> rivers = {};
+
+	// buckets up to the last non-empty one
+	int river_buckets() const
+	{
+		int count = RIVER_BUCKETS;
+		while (count > 0 && rivers[count - 1] == 0) count--;
+		return count;
+	}
+};
+
+// Measures a maze in one depth first walk from the goal, reading the walls of
+// each cell once. Everything else is carried up the walk on the stack: how far
+// each subtree reaches and its deepest side branch, the river and the straight
+// runs leaving each cell. Scratch space is kept, so measuring again allocates
+// nothing.
+//
+// With goals, the walk starts from the first one. The other metrics do not
+// depend on where it starts; with more than one goal, the solution length and
+// branch depth are found by BFS instead, to the nearest goal of each cell.
+class MetricsKernel
+{
+public:
+	template <class MazeType>
+	void measure(const MazeType& maze, MazeMetrics& metrics)
+	{
+		walk(maze, metrics, maze.m_width - 1, maze.m_height - 1);
+	}
+
+	// goals inside the maze, the bottom right corner if empty
+	template <class MazeType>
+	void measure(const MazeType& maze, MazeMetrics& metrics, const std::vector<Maze::CellLocation>& goals)
+	{
+		if (goals.empty())
+		{
+			measure(maze, metrics);
+			return;
+		}
+		walk(maze, metrics, goals[0].x, goals[0].y);
+		if (goals.size() > 1) measure_paths(maze, goals);
+	}
+
+private:
+	static const uint8_t ROOT = 4;
+
+	template <class MazeType>
+	void walk(const MazeType& maze, MazeMetrics& metrics, int root_x, int root_y)
+	{
+		int w = maze.m_width;
+		size_t num_cells = (size_t)w * maze.m_height;
+		metrics = MazeMetrics();
+		m_metrics = &metrics;
+		m_visited.assign((num_cells + 63) / 64, 0);
+		if (m_stack.empty()) m_stack.resize(64);
+		m_depth = 0;
+
+		push(root_x, root_y, w, maze.open_dirs(root_x, root_y), ROOT);
+
+		while (m_depth > 0)
+		{
+			Frame& top = m_stack[m_depth - 1];
+			if (top.children == 0)
+			{
+				pop();
+				continue;
+			}
+
+			// children are tried in direction order
+			static const int dx[4] = { -1, 1, 0, 0 };
+			static const int dy[4] = { 0, 0, -1, 1 };
+			static const uint8_t first_dir[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+			int dir = first_dir[top.children];
+			top.children &= top.children - 1;
+
+			int x = top.x + dx[dir];
+			int y = top.y + dy[dir];
+			uint32_t next = (uint32_t)(x + y * w);
+			if (m_visited[next >> 6] & (1ull << (next & 63))) continue;
+			push(x, y, w, maze.open_dirs(x, y), (uint8_t)dir);
+		}
+
+		m_metrics->solution_cells = m_metrics->solution_length + 1;
+	}
+
+	// A BFS from all the goals finds the farthest cell, then one from the path
+	// back to its nearest goal finds the deepest branch.
+	template <class MazeType>
+	void measure_paths(const MazeType& maze, const std::vector<Maze::CellLocation>& goals)
+	{
+		static const int dx[4] = { -1, 1, 0, 0 };
+		static const int dy[4] = { 0, 0, -1, 1 };
+
+		int w = maze.m_width;
+		size_t num_cells = (size_t)w * maze.m_height;
+		m_distances.assign(num_cells, UINT32_MAX);
+		m_queue.resize(num_cells);
+
+		size_t count = 0;
+		for (const Maze::CellLocation& goal : goals)
+		{
+			uint32_t cell = (uint32_t)(goal.x + goal.y * w);
+			if (m_distances[cell] == 0) continue;
+			m_distances[cell] = 0;
+			m_queue[count++] = cell;
+		}
+		uint32_t farthest = spread(maze, count);
+		m_metrics->solution_length = (int)m_distances[farthest];
+		m_metrics->solution_cells = m_metrics->solution_length + 1;
+
+		// each step back is one nearer the goal
+		m_path.clear();
+		uint32_t cell = farthest;
+		m_path.push_back(cell);
+		while (m_distances[cell] > 0)
+		{
+			int x = (int)(cell % w);
+			int y = (int)(cell / w);
+			unsigned open = maze.open_dirs(x, y);
+			for (int dir = 0; dir < 4; dir++)
+			{
+				if ((open & (1u << dir)) == 0) continue;
+				uint32_t next = (uint32_t)(x + dx[dir] + (y + dy[dir]) * w);
+				if (m_distances[next] + 1 != m_distances[cell]) continue;
+				cell = next;
+				break;
+			}
+			m_path.push_back(cell);
+		}
+
+		m_distances.assign(num_cells, UINT32_MAX);
+		for (size_t i = 0; i < m_path.size(); i++)
+		{
+			m_distances[m_path[i]] = 0;
+			m_queue[i] = m_path[i];
+		}
+		m_metrics->max_branch_depth = (int)m_distances[spread(maze, m_path.size())];
+	}
+
+	// BFS from the first count cells of the queue, returning the last cell reached
+	template <class MazeType>
+	uint32_t spread(const MazeType& maze, size_t count)
+	{
+		static const int dx[4] = { -1, 1, 0, 0 };
+		static const int dy[4] = { 0, 0, -1, 1 };
+
+		int w = maze.m_width;
+		uint32_t cell = m_queue[0];
+		for (size_t head = 0; head < count; head++)
+		{
+			cell = m_queue[head];
+			int x = (int)(cell % w);
+			int y = (int)(cell / w);
+			unsigned open = maze.open_dirs(x, y);
+			for (int dir = 0; dir < 4; dir++)
+			{
+				if ((open & (1u << dir)) == 0) continue;
+				uint32_t next = (uint32_t)(x + dx[dir] + (y + dy[dir]) * w);
+				if (m_distances[next] != UINT32_MAX) continue;
+				m_distances[next] = m_distances[cell] + 1;
+				m_queue[count++] = next;
+			}
+		}
+		return cell;
+	}
+
+	struct Frame
+	{
+		int x;
+		int y;
+
+		// open sides not yet walked through, the side entered by, open side count
+		uint8_t children;
+		uint8_t dir_in;
+		uint8_t degree;
+
+		// farthest distance below, the deepest branch off the path to that farthest
+		// cell found below the tallest child, and the deepest branch of the others
+		uint32_t height;
+		uint32_t path_branch;
+		uint32_t side;
+
+		// river cells below, joined to this cell's river
+		uint32_t river;
+
+		// cells in a straight line from the child in each direction
+		uint32_t straight[4];
+	};
+
+	std::vector<Frame> m_stack;
+	size_t m_depth = 0;
+	std::vector<uint64_t> m_visited;
+	MazeMetrics* m_metrics = nullptr;
+
+	// several goals: distances, BFS queue and the solution path
+	std::vector<uint32_t> m_distances;
+	std::vector<uint32_t> m_queue;
+	std::vector<uint32_t> m_path;
+
+	void push(int x, int y, int width, unsigned open, uint8_t dir_in)
+	{
+		static const uint8_t open_count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+		uint32_t cell = (uint32_t)(x + y * width);
+		m_visited[cell >> 6] |= 1ull << (cell & 63);
+		if (m_depth == m_stack.size()) m_stack.resize(m_depth * 2);
+
+		// the side back to the parent is not a child
+		Frame& frame = m_stack[m_depth++];
+		frame.x = x;
+		frame.y = y;
+		frame.children = (uint8_t)(dir_in == ROOT ? open : open & ~(1u << (dir_in ^ 1)));
+		frame.dir_in = dir_in;
+		frame.degree = open_count[open];
+		frame.height = 0;
+		frame.path_branch = 0;
+		frame.side = 0;
+		frame.river = 0;
+		frame.straight[0] = frame.straight[1] = frame.straight[2] = frame.straight[3] = 0;
+		if (frame.degree == 1) m_metrics->dead_ends++;
+		if (frame.degree >= 3) m_metrics->junctions++;
+	}
+
+	void pop();
+	void add_river(uint32_t length);
+};
+
+// one-off measurement
+template <class MazeType>
+void measure(const MazeType& maze, MazeMetrics& metrics)
+{
+	MetricsKernel kernel;
+	kernel.measure(maze, metrics);
+}
+
+template <class MazeType>
+void measure(const MazeType& maze, MazeMetrics& metrics, const std::vector<Maze::CellLocation>& goals)
+{
+	MetricsKernel kernel;
+	kernel.measure(maze, metrics, goals);
+}
@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <glm.hpp>
+
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include <tiny_gltf.h>
+#include <json.hpp>
+
+#include "maze_model.h"
+#include "geometry.h"
+#include "spool_file.h"
+
+enum Material
+{
+	MAT_GROUND = 0,
+	MAT_PILLAR = 1,
+	MAT_WALL = 2,
+	NUM_MATERIALS = 3,
+};
+
+// lays out one float accessor from offset on, for instance attributes
+static int add_accessor(tinygltf::Model& m_out, size_t& offset, int type, size_t count)
+{
+	offset = (offset + 3) & ~(size_t)3;
+
+	tinygltf::BufferView view;
+	view.buffer = 0;
+	view.byteOffset = offset;
+	view.byteLength = sizeof(float) * tinygltf::GetNumComponentsInType(type) * count;
+	m_out.bufferViews.push_back(view);
+	offset += view.byteLength;
+
+	tinygltf::Accessor acc;
+	acc.bufferView = (int)m_out.bufferViews.size() - 1;
+	acc.byteOffset = 0;
+	acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+	acc.count = count;
+	acc.type = type;
+	m_out.accessors.push_back(acc);
+	return (int)m_out.accessors.size() - 1;
+}
+
+// copies a spool file to the sink a block at a time
+static bool copy_spool(SpoolFile& file, GltfSink& sink)
+{
+	if (!file.rewind()) return false;
+
+	std::vector<char> block(1 << 16);
+	size_t left = file.size();
+	while (left > 0)
+	{
+		size_t n = std::min(left, block.size());
+		if (file.read(block.data(), n) != n || !sink.write(block.data(), n)) return false;
+		left -= n;
+	}
+	return true;
+}
+
+// the BIN chunk of a glb being written
+class GltfFileSink : public GltfSink
+{
+public:
+	GltfFileSink(FILE* file) : m_file(file) {}
+
+protected:
+	bool put(const void* data, size_t length) override
+	{
+		return fwrite(data, 1, length, m_file) == length;
+	}
+
+private:
+	FILE* m_file;
+};
+
+MazeModel::MazeModel(int width, int height, const MeshOptions& options)
+	: m_width(width)
+	, m_height(height)
+	, m_origin_x(-width * 48 / 2)
+	, m_origin_y(-height * 48 / 2)
+	, m_options(options)
+	, m_model(new tinygltf::Model)
+	, m_geometry(NUM_MATERIALS)
+	, m_run_start(width + 1, -1)
+	, m_translations(NUM_MATERIALS)
+{
+	tinygltf::Model& m_out = *m_model;
+	m_out.scenes.resize(1);
+	tinygltf::Scene& scene_out = m_out.scenes[0];
+	scene_out.name = "Scene";
+
+	m_out.asset.version = "2.0";
+	m_out.asset.generator = "tinygltf";
+
+	m_out.buffers.resize(1);
+
+	// sampler
+	m_out.samplers.resize(1);
+	tinygltf::Sampler& sampler = m_out.samplers[0];
+	sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+	sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+
+	// texture
+	struct TexInfo
+	{
+		std::string path;
+		int width;
+		int height;
+	};
+
+	TexInfo tex_info[3] = {
+		{
+			"textures/ground.jpg",
+			1024, 1024
+		},
+		{
+			"textures/pillar.jpg",
+			964, 1024
+		},
+		{
+			"textures/wall_tile.jpg",
+			820, 1024
+		},
+	};
+
+	m_out.images.resize(3);
+	m_out.textures.resize(3);
+
+	for (int i = 0; i < 3; i++)
+	{
+		TexInfo& info = tex_info[i];
+		tinygltf::Image& img_out = m_out.images[i];
+		tinygltf::Texture& tex_out = m_out.textures[i];
+		img_out.width = info.width;
+		img_out.height = info.height;
+		img_out.component = 4;
+		img_out.bits = 8;
+		img_out.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		img_out.uri = info.path;
+
+		tex_out.sampler = 0;
+		tex_out.source = i;
+	}
+
+	// material
+	m_out.materials.resize(3);
+	{
+		tinygltf::Material& material_out = m_out.materials[MAT_GROUND];
+		material_out.name = "ground";
+		material_out.pbrMetallicRoughness.baseColorTexture.index = 0;
+		material_out.pbrMetallicRoughness.metallicFactor = 0.2;
+		material_out.pbrMetallicRoughness.roughnessFactor = 0.1;
+	}
+	{
+		tinygltf::Material& material_out = m_out.materials[MAT_PILLAR];
+		material_out.name = "pillar";
+		material_out.pbrMetallicRoughness.baseColorTexture.index = 1;
+		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
+		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;
+	}
+	{
+		tinygltf::Material& material_out = m_out.materials[MAT_WALL];
+		material_out.name = "wall";
+		material_out.pbrMetallicRoughness.baseColorTexture.index = 2;
+		material_out.pbrMetallicRoughness.metallicFactor = 0.0;
+		material_out.pbrMetallicRoughness.roughnessFactor = 1.0;
+	}
+
+	// node
+	m_out.nodes.resize(1);
+	tinygltf::Node& node_out = m_out.nodes[0];
+	scene_out.nodes.push_back(0);
+
+	// mesh
+	m_out.meshes.resize(1);
+	node_out.mesh = 0;
+}
+
+MazeModel::~MazeModel()
+{
+}
+
+// faces each piece keeps, the hidden ones left out
+static const unsigned PILLAR_FACES = Geometry::FACE_ALL & ~Geometry::FACE_NEG_Y;
+static const unsigned WALL_X_FACES = Geometry::FACE_NEG_X | Geometry::FACE_POS_X | Geometry::FACE_POS_Y;
+static const unsigned WALL_Z_FACES = Geometry::FACE_POS_Y | Geometry::FACE_NEG_Z | Geometry::FACE_POS_Z;
+
+// quads of a ground tile, a pillar and a wall run
+static const int GROUND_QUADS = 1;
+static const int PILLAR_QUADS = 5;
+static const int WALL_QUADS = 3;
+
+void MazeModel::reserve(const PieceCounts& counts)
+{
+	if (m_options.instanced)
+	{
+		m_translations[MAT_GROUND].reserve(m_translations[MAT_GROUND].size() + counts.ground * 3);
+		m_translations[MAT_PILLAR].reserve(m_translations[MAT_PILLAR].size() + counts.pillars * 3);
+		m_translations[MAT_WALL].reserve(m_translations[MAT_WALL].size() + counts.walls * 3);
+		m_wall_rotations.reserve(m_wall_rotations.size() + counts.walls * 4);
+		return;
+	}
+
+	// 4 vertices and 2 triangles a quad
+	m_geometry[MAT_GROUND].reserve(counts.ground * GROUND_QUADS * 4, counts.ground * GROUND_QUADS * 2);
+	m_geometry[MAT_PILLAR].reserve(counts.pillars * PILLAR_QUADS * 4, counts.pillars * PILLAR_QUADS * 2);
+	m_geometry[MAT_WALL].reserve(counts.walls * WALL_QUADS * 4, counts.walls * WALL_QUADS * 2);
+}
+
+// the pillars on the line above row y, x_walls: the walls of row y
+void MazeModel::add_pillar_row(int y, const std::vector<bool>& x_walls)
+{
+	Geometry& pillars = m_geometry[MAT_PILLAR];
+	bool inner_line = y > 0 && y < m_height;
+	for (int x = 0; x < m_width + 1; x++)
+	{
+		// the outer walls touch every pillar on the border
+		if (!m_options.lone_pillars && inner_line && x > 0 && x < m_width)
+		{
+			if (!m_prev_x_walls[x - 1] && !x_walls[x - 1] && !m_prev_y_walls[x - 1] && !m_prev_y_walls[x]) continue;
+		}
+		if (m_options.instanced)
+		{
+			add_instance(MAT_PILLAR, m_origin_x + x * 48, m_origin_y + y * 48);
+			continue;
+		}
+		pillars.generate_pillar(8, 26, 8, m_origin_x + x * 48 - 4, 0, m_origin_y + y * 48 - 4, PILLAR_FACES);
+	}
+}
+
+// walls along z on the line x = column, from row start up to row end
+void MazeModel::add_wall_run_x(int column, int start, int end)
+{
+	m_geometry[MAT_WALL].generate_wall_x(6, 24, (end - start) * 48, m_origin_x + column * 48 - 3, 0, m_origin_y + start * 48, WALL_X_FACES);
+}
+
+// walls along x on the line y = line, from column start up to column end
+void MazeModel::add_wall_run_z(int line, int start, int end)
+{
+	m_geometry[MAT_WALL].generate_wall_z((end - start) * 48, 24, 6, m_origin_x + start * 48, 0, m_origin_y + line * 48 - 3, WALL_Z_FACES);
+}
+
+void MazeModel::add_row(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls)
+{
+	Geometry& ground = m_geometry[MAT_GROUND];
+
+	// ground
+	for (int x = 0; x < m_width; x++)
+	{
+		if (m_options.instanced)
+		{
+			add_instance(MAT_GROUND, m_origin_x + x * 48 + 24, m_origin_y + y * 48 + 24);
+			continue;
+		}
+		ground.generate_ground(48, 48, m_origin_x + x * 48, 0, m_origin_y + y * 48);
+	}
+
+	// pillars
+	add_pillar_row(y, x_walls);
+	if (y == m_height - 1)
+	{
+		add_pillar_row(m_height, x_walls);
+	}
+
+	// walls
+	if (m_options.instanced)
+	{
+		add_wall_instances(y, x_walls, y_walls);
+	}
+	else
+	{
+		add_wall_runs(y, x_walls, y_walls);
+	}
+
+	if (!m_options.lone_pillars)
+	{
+		m_prev_x_walls = x_walls;
+		m_prev_y_walls = y_walls;
+	}
+
+	if (m_spooled) spool_row();
+}
+
+void MazeModel::spool()
+{
+	m_spooled = true;
+	for (int material = 0; material < NUM_MATERIALS; material++)
+	{
+		if (m_options.instanced)
+		{
+			m_translation_spools.emplace_back(new SpoolFile);
+		}
+		else
+		{
+			m_geometry_spools.emplace_back(new GeometrySpool);
+		}
+	}
+	if (m_options.instanced) m_rotation_spool.reset(new SpoolFile);
+}
+
+void MazeModel::spool_row()
+{
+	for (int material = 0; material < NUM_MATERIALS; material++)
+	{
+		if (!m_options.instanced)
+		{
+			m_geometry_spools[material]->append(m_geometry[material]);
+			continue;
+		}
+		std::vector<float>& translations = m_translations[material];
+		m_translation_spools[material]->write(translations.data(), sizeof(float) * translations.size());
+		translations.clear();
+	}
+	if (m_options.instanced)
+	{
+		m_rotation_spool->write(m_wall_rotations.data(), sizeof(float) * m_wall_rotations.size());
+		m_wall_rotations.clear();
+	}
+}
+
+void MazeModel::add_wall_runs(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls)
+{
+	// outer walls along x
+	if (y == 0)
+	{
+		add_wall_run_z(0, 0, m_width);
+	}
+	if (y == m_height - 1)
+	{
+		add_wall_run_z(m_height, 0, m_width);
+	}
+
+	// walls along z, the outer ones included, continue the runs of the rows above
+	for (int column = 0; column <= m_width; column++)
+	{
+		bool wall = column == 0 || column == m_width || x_walls[column - 1];
+		int& start = m_run_start[column];
+		if (wall && start < 0)
+		{
+			start = y;
+		}
+		else if (!wall && start >= 0)
+		{
+			add_wall_run_x(column, start, y);
+			start = -1;
+		}
+	}
+
+	if (y == m_height - 1)
+	{
+		for (int column = 0; column <= m_width; column++)
+		{
+			if (m_run_start[column] >= 0) add_wall_run_x(column, m_run_start[column], m_height);
+			m_run_start[column] = -1;
+		}
+	}
+
+	// maze walls below the row
+	if (y < m_height - 1)
+	{
+		int start = -1;
+		for (int x = 0; x <= m_width; x++)
+		{
+			bool wall = x < m_width && y_walls[x];
+			if (wall && start < 0)
+			{
+				start = x;
+			}
+			else if (!wall && start >= 0)
+			{
+				add_wall_run_z(y + 1, start, x);
+				start = -1;
+			}
+		}
+	}
+}
+
+void MazeModel::add_instance(int material, int x, int z)
+{
+	// quantized, the node scales units to meters after the instance transform
+	float scale = m_options.quantized ? 1.0f : Geometry::unit;
+	std::vector<float>& translations = m_translations[material];
+	translations.push_back((float)x * scale);
+	translations.push_back(0.0f);
+	translations.push_back(-(float)z * scale);
+}
+
+// the prototype runs along z, walls along x are turned a quarter around y
+void MazeModel::add_wall_instance(int x, int z, bool along_x)
+{
+	add_instance(MAT_WALL, x, z);
+	float s = along_x ? sqrtf(0.5f) : 0.0f;
+	float c = along_x ? sqrtf(0.5f) : 1.0f;
+	m_wall_rotations.insert(m_wall_rotations.end(), { 0.0f, s, 0.0f, c });
+}
+
+void MazeModel::add_wall_instances(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls)
+{
+	// outer walls along x
+	if (y == 0 || y == m_height - 1)
+	{
+		int line = y == 0 ? 0 : m_height;
+		for (int x = 0; x < m_width; x++)
+		{
+			add_wall_instance(m_origin_x + x * 48 + 24, m_origin_y + line * 48, true);
+		}
+	}
+
+	// walls along z, the outer ones included
+	for (int column = 0; column <= m_width; column++)
+	{
+		if (column == 0 || column == m_width || x_walls[column - 1])
+		{
+			add_wall_instance(m_origin_x + column * 48, m_origin_y + y * 48 + 24, false);
+		}
+	}
+
+	// maze walls below the row
+	if (y < m_height - 1)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			if (y_walls[x]) add_wall_instance(m_origin_x + x * 48 + 24, m_origin_y + (y + 1) * 48, true);
+		}
+	}
+}
+
+// for quantized positions in units
+static void scale_node(tinygltf::Node& node_out)
+{
+	node_out.scale = { Geometry::unit, Geometry::unit, Geometry::unit };
+}
+
+static void add_extension(tinygltf::Model& m_out, const std::string& name)
+{
+	if (std::find(m_out.extensionsUsed.begin(), m_out.extensionsUsed.end(), name) != m_out.extensionsUsed.end()) return;
+	m_out.extensionsUsed.push_back(name);
+	m_out.extensionsRequired.push_back(name);
+}
+
+void MazeModel::add_primitive(int mesh, int material, const GeometryStats& stats)
+{
+	tinygltf::Model& m_out = *m_model;
+	tinygltf::Primitive prim_out;
+	prim_out.material = material;
+	prim_out.mode = TINYGLTF_MODE_TRIANGLES;
+	m_buffer_size = Geometry::gltf_layout(m_out, prim_out, stats, m_options.quantized, m_buffer_size);
+	m_out.meshes[mesh].primitives.push_back(prim_out);
+	if (!m_options.quantized) return;
+
+	// one primitive per material, so the material can scale its texcoords back
+	glm::vec2 uv_scale = stats.uv_scale();
+	if (uv_scale.x != 1.0f || uv_scale.y != 1.0f)
+	{
+		tinygltf::Value::Object transform;
+		transform["scale"] = tinygltf::Value(tinygltf::Value::Array{ tinygltf::Value((double)uv_scale.x), tinygltf::Value((double)uv_scale.y) });
+		m_out.materials[material].pbrMetallicRoughness.baseColorTexture.extensions["KHR_texture_transform"] = tinygltf::Value(transform);
+		add_extension(m_out, "KHR_texture_transform");
+	}
+}
+
+std::function<bool(GltfSink&)> MazeModel::float_writer(std::vector<float>& values, SpoolFile* spool)
+{
+	if (spool != nullptr)
+	{
+		return [spool](GltfSink& sink) { return sink.align() && copy_spool(*spool, sink); };
+	}
+	return [&values](GltfSink& sink)
+	{
+		bool ok = sink.align() && sink.write(values.data(), sizeof(float) * values.size());
+
+		// the buffer holds a copy now
+		std::vector<float>().swap(values);
+		return ok;
+	};
+}
+
+void MazeModel::finish()
+{
+	if (m_finished) return;
+	m_finished = true;
+
+	if (m_options.instanced)
+	{
+		finish_instanced();
+	}
+	else
+	{
+		finish_merged();
+	}
+
+	// spooled, save() writes the views straight to the file
+	if (m_spooled) return;
+
+	// the buffer grows once
+	std::vector<unsigned char>& data = m_model->buffers[0].data;
+	data.reserve(m_buffer_size);
+	GltfBufferSink sink(data);
+	for (std::function<bool(GltfSink&)>& writer : m_view_writers)
+	{
+		writer(sink);
+	}
+	m_view_writers.clear();
+}
+
+void MazeModel::finish_merged()
+{
+	tinygltf::Model& m_out = *m_model;
+	if (m_options.quantized)
+	{
+		add_extension(m_out, "KHR_mesh_quantization");
+		scale_node(m_out.nodes[0]);
+	}
+
+	bool quantized = m_options.quantized;
+	for (int material = 0; material < NUM_MATERIALS; material++)
+	{
+		if (m_spooled)
+		{
+			GeometrySpool* spool = m_geometry_spools[material].get();
+			if (spool->stats().num_faces == 0) continue;
+			add_primitive(0, material, spool->stats());
+			m_view_writers.push_back([spool, quantized](GltfSink& sink) { return spool->write_gltf(sink, quantized); });
+			continue;
+		}
+
+		Geometry* geo = &m_geometry[material];
+		GeometryStats stats = geo->stats();
+		if (stats.num_faces == 0) continue;
+		add_primitive(0, material, stats);
+		m_view_writers.push_back([geo, stats, quantized](GltfSink& sink)
+		{
+			bool ok = geo->write_gltf(sink, stats, quantized);
+
+			// the buffer holds a copy now
+			*geo = Geometry();
+			return ok;
+		});
+	}
+}
+
+void MazeModel::finish_instanced()
+{
+	tinygltf::Model& m_out = *m_model;
+	add_extension(m_out, "EXT_mesh_gpu_instancing");
+	if (m_options.quantized) add_extension(m_out, "KHR_mesh_quantization");
+
+	// one node and mesh per piece, each prototype centered on the origin;
+	// instanced, the geometry holds the prototypes
+	m_geometry[MAT_GROUND].generate_ground(48, 48, -24, 0, -24);
+	m_geometry[MAT_PILLAR].generate_pillar(8, 26, 8, -4, 0, -4, PILLAR_FACES);
+	m_geometry[MAT_WALL].generate_wall_x(6, 24, 48, -3, 0, -24, WALL_X_FACES);
+
+	const char* names[NUM_MATERIALS] = { "ground", "pillars", "walls" };
+	m_out.meshes.resize(NUM_MATERIALS);
+	m_out.nodes.resize(NUM_MATERIALS);
+	m_out.scenes[0].nodes.clear();
+	bool quantized = m_options.quantized;
+	for (int material = 0; material < NUM_MATERIALS; material++)
+	{
+		const Geometry* proto = &m_geometry[material];
+		GeometryStats stats = proto->stats();
+		add_primitive(material, material, stats);
+		m_view_writers.push_back([proto, stats, quantized](GltfSink& sink) { return proto->write_gltf(sink, stats, quantized); });
+
+		SpoolFile* spool = m_spooled ? m_translation_spools[material].get() : nullptr;
+		size_t count = (spool != nullptr ? spool->size() / sizeof(float) : m_translations[material].size()) / 3;
+		tinygltf::Value::Object attributes;
+		attributes["TRANSLATION"] = tinygltf::Value(add_accessor(m_out, m_buffer_size, TINYGLTF_TYPE_VEC3, count));
+		m_view_writers.push_back(float_writer(m_translations[material], spool));
+		if (material == MAT_WALL)
+		{
+			attributes["ROTATION"] = tinygltf::Value(add_accessor(m_out, m_buffer_size, TINYGLTF_TYPE_VEC4, count));
+			m_view_writers.push_back(float_writer(m_wall_rotations, m_rotation_spool.get()));
+		}
+
+		tinygltf::Value::Object instancing;
+		instancing["attributes"] = tinygltf::Value(attributes);
+
+		tinygltf::Node& node_out = m_out.nodes[material];
+		node_out.name = names[material];
+		node_out.mesh = material;
+		node_out.extensions["EXT_mesh_gpu_instancing"] = tinygltf::Value(instancing);
+		if (m_options.quantized) scale_node(node_out);
+		m_out.scenes[0].nodes.push_back(material);
+	}
+}
+
+tinygltf::Model& MazeModel::model()
+{
+	finish();
+	return *m_model;
+}
+
+bool MazeModel::save(const std::string& path)
+{
+	finish();
+	if (m_spooled) return save_spooled(path);
+
+	tinygltf::TinyGLTF gltf;
+	return gltf.WriteGltfSceneToFile(m_model.get(), path, true, true, false, true);
+}
+
+bool MazeModel::save(std::vector<unsigned char>& glb)
+{
+	finish();
+	if (m_spooled) return false;
+
+	tinygltf::TinyGLTF gltf;
+	std::ostringstream stream;
+	if (!gltf.WriteGltfSceneToStream(m_model.get(), stream, false, true)) return false;
+
+	std::string data = stream.str();
+	glb.assign(data.begin(), data.end());
+	return true;
+}
+
+// tinygltf only writes a glb from a buffer in memory, so the chunks are written
+// here: tinygltf's json with the buffer's length put in, then the views one by one.
+bool MazeModel::save_spooled(const std::string& path)
+{
+	for (const std::unique_ptr<GeometrySpool>& spool : m_geometry_spools)
+	{
+		if (!spool->ok()) return false;
+	}
+	for (const std::unique_ptr<SpoolFile>& spool : m_translation_spools)
+	{
+		if (!spool->ok()) return false;
+	}
+	if (m_rotation_spool && !m_rotation_spool->ok()) return false;
+
+	// without buffer data tinygltf writes only the json chunk
+	tinygltf::TinyGLTF gltf;
+	std::ostringstream stream;
+	if (!gltf.WriteGltfSceneToStream(m_model.get(), stream, false, true)) return false;
+	std::string empty_glb = stream.str();
+	uint32_t json_length;
+	memcpy(&json_length, empty_glb.data() + 12, sizeof(json_length));
+	nlohmann::json json = nlohmann::json::parse(empty_glb.substr(20, json_length));
+	json["buffers"][0]["byteLength"] = m_buffer_size;
+
+	std::string json_chunk = json.dump();
+	json_chunk.resize((json_chunk.size() + 3) & ~(size_t)3, ' ');
+	size_t bin_length = (m_buffer_size + 3) & ~(size_t)3;
+
+	// the lengths in a glb are 32 bit
+	uint64_t length = 12 + 8 + (uint64_t)json_chunk.size() + 8 + bin_length;
+	if (length > UINT32_MAX) return false;
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr) return false;
+
+	uint32_t header[5] = { 0x46546C67, 2, (uint32_t)length, (uint32_t)json_chunk.size(), 0x4E4F534A };
+	uint32_t bin_header[2] = { (uint32_t)bin_length, 0x004E4942 };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1
+		&& fwrite(json_chunk.data(), 1, json_chunk.size(), file) == json_chunk.size()
+		&& fwrite(bin_header, sizeof(bin_header), 1, file) == 1;
+
+	GltfFileSink sink(file);
+	for (std::function<bool(GltfSink&)>& writer : m_view_writers)
+	{
+		ok = ok && writer(sink);
+	}
+	ok = ok && sink.align() && sink.offset() == bin_length;
+	return fclose(file) == 0 && ok;
+}
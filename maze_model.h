@@ -0,0 +1,220 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+
+namespace tinygltf
+{
+	class Model;
+}
+
+class Geometry;
+class GeometrySpool;
+struct GeometryStats;
+class GltfSink;
+class SpoolFile;
+
+// How a maze is turned into a mesh
+struct MeshOptions
+{
+	// false leaves out the pillars no wall touches
+	bool lone_pillars = true;
+
+	// One prototype mesh per piece, a ground tile, a pillar and a wall segment,
+	// placed by EXT_mesh_gpu_instancing, instead of all pieces merged per material.
+	// Needs a loader that knows the extension.
+	bool instanced = false;
+
+	// Positions, normals, texcoords and indices written in 16 and 8 bit integers,
+	// declared by KHR_mesh_quantization. The nodes scale the positions back to meters.
+	bool quantized = false;
+};
+
+// Builds the glb scene of a maze row by row, so a maze can be meshed
+// without its grid ever existing as a whole in memory. The mesh itself is
+// kept until save(), peaking at about 2 KB per cell while the glb is written,
+// or 100 bytes instanced, unless it is spooled to temporary files row by row.
+//
+// Pieces are appended to one Geometry per material, and the mesh gets one
+// primitive per material when the model is saved: 3 draw calls however large
+// the maze.
+//
+// Walls in a line are merged into one box per maximal run, textured
+// continuously along it. Runs along a row are found within the row; runs
+// across rows are kept open per column until a row breaks them.
+//
+// Faces nobody can see are left out: the bottoms of walls and pillars, which
+// sit on the ground, and the ends of wall runs, which are inside pillars.
+//
+// Instanced, only a translation per piece is kept, and a rotation per wall
+// segment; the geometry written is the same three prototypes at any size.
+//
+// Quantized, the wall texcoords run past 1 and are scaled back up by a
+// KHR_texture_transform on the wall material.
+//
+// Given a whole maze, the pieces are counted from its walls first and the
+// mesh is allocated once at its final size. Rows added one by one grow it.
+class MazeModel
+{
+public:
+	MazeModel(int width, int height, const MeshOptions& options = MeshOptions());
+	~MazeModel();
+
+	// From here on, the pieces of every row are moved to temporary files, and
+	// save(path) writes them from there, so memory no longer grows with the
+	// maze's length. Call before the first row. A spooled model can only be
+	// saved to a file: save(glb) fails, and model() has no buffer data.
+	// A glb holds at most 4 GB, about 3.5 million cells merged, 5 million
+	// quantized or 80 million instanced; save fails past that.
+	void spool();
+
+	// Rows must be added in order, y = 0 .. height - 1.
+	// x_walls: the width - 1 walls right of the cells of row y.
+	// y_walls: the width walls below row y, ignored for the last row.
+	void add_row(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls);
+
+	// pieces of each kind in a mesh: wall runs, or wall segments when instanced
+	struct PieceCounts
+	{
+		size_t ground = 0;
+		size_t pillars = 0;
+		size_t walls = 0;
+	};
+
+	// any maze type with has_x_wall / has_y_wall: Maze or FixedMaze
+	template <class MazeType>
+	PieceCounts count_pieces(const MazeType& maze) const
+	{
+		PieceCounts counts;
+		counts.ground = (size_t)m_width * m_height;
+		counts.pillars = (size_t)(m_width + 1) * (m_height + 1);
+
+		// the outer walls are 4 runs
+		size_t runs = 4;
+		size_t segments = 2 * (size_t)(m_width + m_height);
+		for (int y = 0; y < m_height; y++)
+		{
+			for (int x = 0; x < m_width - 1; x++)
+			{
+				if (!maze.has_x_wall(x, y)) continue;
+				segments++;
+				if (y == 0 || !maze.has_x_wall(x, y - 1)) runs++;
+			}
+			if (y == m_height - 1) break;
+			for (int x = 0; x < m_width; x++)
+			{
+				if (!maze.has_y_wall(x, y)) continue;
+				segments++;
+				if (x == 0 || !maze.has_y_wall(x - 1, y)) runs++;
+			}
+		}
+		counts.walls = m_options.instanced ? segments : runs;
+
+		if (!m_options.lone_pillars)
+		{
+			for (int y = 1; y < m_height; y++)
+			{
+				for (int x = 1; x < m_width; x++)
+				{
+					if (!maze.has_x_wall(x - 1, y - 1) && !maze.has_x_wall(x - 1, y) && !maze.has_y_wall(x - 1, y - 1) && !maze.has_y_wall(x, y - 1)) counts.pillars--;
+				}
+			}
+		}
+		return counts;
+	}
+
+	// makes room for this many more pieces
+	void reserve(const PieceCounts& counts);
+
+	template <class MazeType>
+	void add_maze(const MazeType& maze)
+	{
+		reserve(count_pieces(maze));
+
+		std::vector<bool> x_walls(m_width - 1);
+		std::vector<bool> y_walls(m_width);
+		for (int y = 0; y < m_height; y++)
+		{
+			for (int x = 0; x < m_width - 1; x++)
+			{
+				x_walls[x] = maze.has_x_wall(x, y);
+			}
+			if (y < m_height - 1)
+			{
+				for (int x = 0; x < m_width; x++)
+				{
+					y_walls[x] = maze.has_y_wall(x, y);
+				}
+			}
+			add_row(y, x_walls, y_walls);
+		}
+	}
+
+	bool save(const std::string& path);
+
+	// the same glb as save() would write, kept in memory
+	bool save(std::vector<unsigned char>& glb);
+
+	// the scene with its primitives emitted, no rows can be added after this
+	tinygltf::Model& model();
+
+private:
+	int m_width;
+	int m_height;
+	int m_origin_x;
+	int m_origin_y;
+	MeshOptions m_options;
+
+	std::unique_ptr<tinygltf::Model> m_model;
+
+	// pieces merged by material, until finish() writes them to the model
+	std::vector<Geometry> m_geometry;
+	bool m_finished = false;
+
+	// spooled: the pieces of each material, or instanced the translations of
+	// each and the wall rotations, moved out after every row
+	bool m_spooled = false;
+	std::vector<std::unique_ptr<GeometrySpool>> m_geometry_spools;
+	std::vector<std::unique_ptr<SpoolFile>> m_translation_spools;
+	std::unique_ptr<SpoolFile> m_rotation_spool;
+
+	// the bytes finish() laid out in buffer 0, and the writers of their data in order
+	size_t m_buffer_size = 0;
+	std::vector<std::function<bool(GltfSink&)>> m_view_writers;
+
+	// for each of the width + 1 wall columns, the row its open run of walls began in, -1 if none
+	std::vector<int> m_run_start;
+
+	// instanced: x, y, z of every piece by material, and x, y, z, w of every wall's rotation
+	std::vector<std::vector<float>> m_translations;
+	std::vector<float> m_wall_rotations;
+
+	// the walls of the row above, to find the lone pillars between it and the current row
+	std::vector<bool> m_prev_x_walls;
+	std::vector<bool> m_prev_y_walls;
+
+	void add_pillar_row(int y, const std::vector<bool>& x_walls);
+	void add_wall_run_x(int column, int start, int end);
+	void add_wall_run_z(int line, int start, int end);
+	void add_wall_runs(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls);
+
+	// x and z in units, for a piece centered there
+	void add_instance(int material, int x, int z);
+	void add_wall_instance(int x, int z, bool along_x);
+	void add_wall_instances(int y, const std::vector<bool>& x_walls, const std::vector<bool>& y_walls);
+
+	void spool_row();
+
+	// one primitive of the material on the mesh, quantized if asked, laid out from its stats
+	void add_primitive(int mesh, int material, const GeometryStats& stats);
+
+	// the data of an instance attribute, from memory or from its spool file if spooled
+	static std::function<bool(GltfSink&)> float_writer(std::vector<float>& values, SpoolFile* spool);
+
+	void finish();
+	void finish_merged();
+	void finish_instanced();
+	bool save_spooled(const std::string& path);
+};
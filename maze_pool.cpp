@@ -0,0 +1,122 @@
+#include <chrono>
+#include "maze_pool.h"
+
+MazePool::MazePool(const MazeRequest& config, int capacity, int num_threads)
+	: m_config(config)
+	, m_capacity(capacity)
+	, m_stop(false)
+	, m_building(0)
+	, m_total_refill_ms(0.0)
+{
+	m_config.seed = 0;
+	m_config.tile_size = 0;
+	m_config.difficulty = DifficultyTarget();
+
+	// kept for every pooled maze, so requests for distances can be served too
+	m_config.distances = true;
+	m_config.path.clear();
+	m_stats.capacity = capacity;
+
+	if (num_threads < 1) num_threads = 1;
+	for (int i = 0; i < num_threads; i++)
+	{
+		m_threads.emplace_back(&MazePool::refill, this);
+	}
+}
+
+MazePool::~MazePool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+bool MazePool::matches(const MazeRequest& request, bool has_seed) const
+{
+	if (has_seed || request.tile_size > 0 || request.difficulty.active()) return false;
+	if (request.width != m_config.width || request.height != m_config.height) return false;
+	if (request.algorithm != m_config.algorithm || request.fair_starts != m_config.fair_starts) return false;
+	if (request.mesh.lone_pillars != m_config.mesh.lone_pillars || request.mesh.instanced != m_config.mesh.instanced) return false;
+	if (request.mesh.quantized != m_config.mesh.quantized) return false;
+
+	if (request.goals.size() != m_config.goals.size()) return false;
+	for (size_t i = 0; i < request.goals.size(); i++)
+	{
+		if (request.goals[i].x != m_config.goals[i].x || request.goals[i].y != m_config.goals[i].y) return false;
+	}
+	return true;
+}
+
+bool MazePool::claim(PooledMaze& maze)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_ready.empty())
+		{
+			m_stats.misses++;
+			return false;
+		}
+		maze = std::move(m_ready.front());
+		m_ready.pop_front();
+		m_stats.hits++;
+	}
+	m_cond.notify_one();
+	return true;
+}
+
+MazePoolStats MazePool::stats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	MazePoolStats stats = m_stats;
+	stats.ready = (int)m_ready.size();
+	return stats;
+}
+
+void MazePool::refill()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this]() { return m_stop || (int)m_ready.size() + m_building < m_capacity; });
+			if (m_stop) return;
+			m_building++;
+		}
+
+		Clock::time_point start = Clock::now();
+
+		MazeRequest request = m_config;
+		request.seed = Random::random_seed();
+
+		MazeResult result;
+		PooledMaze maze;
+		build_maze(request, nullptr, result, maze.glb);
+		maze.seed = result.seed;
+		maze.start_points = std::move(result.start_points);
+		maze.metrics = result.metrics;
+		maze.distances = std::move(result.distances);
+		maze.nearest_goals = std::move(result.nearest_goals);
+
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_building--;
+		if (result.saved)
+		{
+			m_ready.push_back(std::move(maze));
+		}
+		m_stats.refills++;
+		m_stats.last_refill_ms = ms;
+		if (ms > m_stats.max_refill_ms) m_stats.max_refill_ms = ms;
+		m_total_refill_ms += ms;
+		m_stats.avg_refill_ms = m_total_refill_ms / (double)m_stats.refills;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include "batch.h"
+
+// A maze built ahead of time, ready to be written out
+struct PooledMaze
+{
+	uint64_t seed = 0;
+	std::vector<Maze::CellLocation> start_points;
+	MazeMetrics metrics;
+	std::vector<uint32_t> distances;
+	std::vector<uint32_t> nearest_goals;
+	std::vector<unsigned char> glb;
+};
+
+struct MazePoolStats
+{
+	int capacity = 0;
+	int ready = 0;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t refills = 0;
+
+	// time to build one pooled maze, in milliseconds
+	double last_refill_ms = 0.0;
+	double avg_refill_ms = 0.0;
+	double max_refill_ms = 0.0;
+};
+
+// Keeps up to capacity mazes of one configuration built in memory,
+// topped up by its own background threads as mazes are claimed
+class MazePool
+{
+public:
+	// config.seed and config.path are ignored, every pooled maze gets a fresh seed
+	MazePool(const MazeRequest& config, int capacity, int num_threads = 1);
+	~MazePool();
+
+	// whether a request can be served from this pool: same size, algorithm, goals and start placement,
+	// no explicit seed, no tiling and no difficulty target
+	bool matches(const MazeRequest& request, bool has_seed) const;
+
+	// Takes a ready maze. Returns false (and counts a miss) if none is ready.
+	bool claim(PooledMaze& maze);
+
+	MazePoolStats stats();
+
+private:
+	MazeRequest m_config;
+	int m_capacity;
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop;
+
+	std::deque<PooledMaze> m_ready;
+
+	// mazes being built right now, counted against the capacity
+	int m_building;
+
+	MazePoolStats m_stats;
+	double m_total_refill_ms;
+
+	void refill();
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <random>
+
+// xoshiro256** pseudo-random generator, seeded through splitmix64.
+// Each maze owns one, so mazes can be generated concurrently and
+// regenerated from their seed.
+class Random
+{
+public:
+	Random(uint64_t seed)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			m_state[i] = splitmix64(seed);
+		}
+	}
+
+	uint64_t next()
+	{
+		uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+		uint64_t t = m_state[1] << 17;
+
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+
+		m_state[2] ^= t;
+		m_state[3] = rotl(m_state[3], 45);
+
+		return result;
+	}
+
+	// uniform integer in [0, n)
+	int next_int(int n)
+	{
+		return (int)(((next() >> 32) * (uint64_t)n) >> 32);
+	}
+
+	bool next_bool()
+	{
+		return (next() >> 63) != 0;
+	}
+
+	static uint64_t splitmix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// seeds are kept within 53 bits so they survive a round trip through a JavaScript number
+	static const uint64_t max_seed = (1ull << 53) - 1;
+
+	// a fresh seed from the system entropy source
+	static uint64_t random_seed()
+	{
+		std::random_device device;
+		uint64_t state = ((uint64_t)device() << 32) ^ (uint64_t)device();
+		state ^= (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+		return splitmix64(state) & max_seed;
+	}
+
+private:
+	uint64_t m_state[4];
+
+	static uint64_t rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+};
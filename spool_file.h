@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdio>
+
+// An anonymous temporary file, for data too large to keep in memory. Written
+// to the end, then read back from the start; removed when closed.
+class SpoolFile
+{
+public:
+	SpoolFile() : m_file(tmpfile()), m_failed(m_file == nullptr) {}
+	~SpoolFile()
+	{
+		if (m_file != nullptr) fclose(m_file);
+	}
+
+	SpoolFile(const SpoolFile&) = delete;
+	SpoolFile& operator=(const SpoolFile&) = delete;
+
+	// false if the file could not be made or a write failed, the disk being full
+	bool ok() const { return !m_failed; }
+
+	// bytes written
+	size_t size() const { return m_size; }
+
+	void write(const void* data, size_t length)
+	{
+		if (m_failed || length == 0) return;
+		m_failed = fwrite(data, 1, length, m_file) != length;
+		m_size += length;
+	}
+
+	// back to the start, for read()
+	bool rewind()
+	{
+		return !m_failed && fflush(m_file) == 0 && fseek(m_file, 0, SEEK_SET) == 0;
+	}
+
+	size_t read(void* data, size_t length)
+	{
+		return fread(data, 1, length, m_file);
+	}
+
+private:
+	FILE* m_file;
+	bool m_failed;
+	size_t m_size = 0;
+};
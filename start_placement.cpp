@@ -0,0 +1,115 @@
+#include "start_placement.h"
+
+bool StartPlacement::sort_levels(const std::vector<uint32_t>& steps)
+{
+	uint32_t num_cells = (uint32_t)steps.size();
+	m_level_start.clear();
+	for (uint32_t cell = 0; cell < num_cells; cell++)
+	{
+		uint32_t s = steps[cell];
+		if (s == Maze::UNREACHED) continue;
+		if (s + 2 >= m_level_start.size()) m_level_start.resize(s + 3, 0);
+		m_level_start[s + 2]++;
+	}
+	if (m_level_start.size() < 3) return false;
+
+	// counting sort by distance, afterwards m_level_start[d] is the start of distance d
+	uint32_t num_levels = (uint32_t)m_level_start.size() - 1;
+	for (uint32_t d = 2; d <= num_levels; d++)
+	{
+		m_level_start[d] += m_level_start[d - 1];
+	}
+	uint32_t num_reached = m_level_start[num_levels];
+	m_order.resize(num_reached);
+	m_position.resize(num_cells);
+	m_parent.resize(num_reached);
+	m_reach.resize(num_reached);
+	m_deepest.resize(num_reached);
+	for (uint32_t cell = 0; cell < num_cells; cell++)
+	{
+		uint32_t s = steps[cell];
+		if (s == Maze::UNREACHED) continue;
+		uint32_t i = m_level_start[s + 1]++;
+		m_order[i] = cell;
+		m_position[cell] = i;
+	}
+	m_level_start.pop_back();
+	return true;
+}
+
+bool StartPlacement::place_on_tree(int width, int k, std::vector<Maze::CellLocation>& starts)
+{
+	// how far each subtree reaches, children before their parents
+	uint32_t num_reached = (uint32_t)m_order.size();
+	uint32_t max_steps = (uint32_t)m_level_start.size() - 2;
+	for (uint32_t d = 0; d <= max_steps; d++)
+	{
+		for (uint32_t i = m_level_start[d]; i < m_level_start[d + 1]; i++)
+		{
+			m_reach[i] = d;
+			m_deepest[i] = i;
+		}
+	}
+	for (uint32_t i = num_reached; i-- > m_level_start[1];)
+	{
+		uint32_t parent = m_parent[i];
+		if (m_reach[i] > m_reach[parent])
+		{
+			m_reach[parent] = m_reach[i];
+			m_deepest[parent] = m_deepest[i];
+		}
+	}
+
+	// k subtrees hanging at distance d reach down to m together: starts at distance m
+	// are at least 2 * (m - d + 1) apart. Ties go to the farther m.
+	uint32_t best_level = 0;
+	uint32_t best_steps = 0;
+	uint32_t best_gap = 0;
+	for (uint32_t d = 1; d <= max_steps; d++)
+	{
+		if (m_level_start[d + 1] - m_level_start[d] < (uint32_t)k) continue;
+		collect_top(d, k);
+		uint32_t m = m_reach[m_top[k - 1]];
+		uint32_t gap = m - d + 1;
+		if (gap > best_gap || (gap == best_gap && m > best_steps))
+		{
+			best_level = d;
+			best_steps = m;
+			best_gap = gap;
+		}
+	}
+	if (best_level == 0) return false;
+
+	// climb from the deepest cell of each subtree to distance m
+	collect_top(best_level, k);
+	starts.clear();
+	for (int i = 0; i < k; i++)
+	{
+		uint32_t pos = m_deepest[m_top[i]];
+		while (pos >= m_level_start[best_steps + 1]) pos = m_parent[pos];
+		uint32_t cell = m_order[pos];
+		starts.push_back({ (int)(cell % width), (int)(cell / width) });
+	}
+	m_spread = best_gap * 2;
+	return true;
+}
+
+void StartPlacement::collect_top(uint32_t level, int k)
+{
+	// insertion into a list of at most k, farthest reaching first
+	m_top.clear();
+	for (uint32_t i = m_level_start[level]; i < m_level_start[level + 1]; i++)
+	{
+		uint32_t reach = m_reach[i];
+		if ((int)m_top.size() == k && reach <= m_reach[m_top[k - 1]]) continue;
+		if ((int)m_top.size() < k) m_top.push_back(i);
+
+		size_t j = m_top.size() - 1;
+		while (j > 0 && m_reach[m_top[j - 1]] < reach)
+		{
+			m_top[j] = m_top[j - 1];
+			j--;
+		}
+		m_top[j] = i;
+	}
+}
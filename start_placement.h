@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+
+// Start points that are fair to every player: k cells at exactly the same
+// distance to the goal, spread as far apart as the maze allows.
+//
+// The BFS from the goal makes the maze a tree rooted at the goal. Two cells at
+// distance m whose paths to the goal join at distance s are 2 * (m - s) apart,
+// so k cells at distance m are at least 2 * (m - s) apart when they lie in k
+// different subtrees hanging at distance s + 1. Knowing how deep every subtree
+// reaches, one pass over the levels finds the s and m giving the largest
+// minimum distance, which no other choice of k equally far cells can beat.
+// Everything is linear in the number of cells.
+//
+// With several goals the distances are to the nearest goal and the tree is a
+// forest, one tree per goal. Cells are then spread by where their ways to the
+// goals part; cells near a border between two goals' regions can be closer
+// than spread() across it.
+class StartPlacement
+{
+public:
+	// steps: distance of every cell to the goal, as handed out by take_distances.
+	// Returns false and leaves starts alone if no k cells share a distance.
+	template <class MazeType>
+	bool place(const MazeType& maze, const std::vector<uint32_t>& steps, int k, std::vector<Maze::CellLocation>& starts)
+	{
+		m_spread = 0;
+		if (k <= 0 || !sort_levels(steps)) return false;
+
+		// link every cell to the neighbor one step nearer the goal, by sorted position
+		int w = maze.m_width;
+		for (int y = 0; y < maze.m_height; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				uint32_t cell = (uint32_t)(x + y * w);
+				uint32_t s = steps[cell];
+				if (s == Maze::UNREACHED || s == 0) continue;
+
+				unsigned dirs = maze.open_dirs(x, y);
+				uint32_t parent = cell;
+				if ((dirs & Maze::OPEN_NEG_X) && steps[cell - 1] == s - 1) parent = cell - 1;
+				else if ((dirs & Maze::OPEN_POS_X) && steps[cell + 1] == s - 1) parent = cell + 1;
+				else if ((dirs & Maze::OPEN_NEG_Y) && steps[cell - w] == s - 1) parent = cell - w;
+				else if ((dirs & Maze::OPEN_POS_Y) && steps[cell + w] == s - 1) parent = cell + w;
+				m_parent[m_position[cell]] = m_position[parent];
+			}
+		}
+
+		return place_on_tree(w, k, starts);
+	}
+
+	// the last placement keeps every two start cells at least this far apart, 0 if none
+	uint32_t spread() const { return m_spread; }
+
+private:
+	// cells ordered by distance, m_level_start[d] is where distance d begins
+	std::vector<uint32_t> m_order;
+	std::vector<uint32_t> m_level_start;
+	std::vector<uint32_t> m_position;
+
+	// by sorted position: the parent's position, how far the subtree reaches
+	// and the position of a cell that far
+	std::vector<uint32_t> m_parent;
+	std::vector<uint32_t> m_reach;
+	std::vector<uint32_t> m_deepest;
+
+	// positions of the k cells of one level with the farthest reaching subtrees
+	std::vector<uint32_t> m_top;
+
+	uint32_t m_spread = 0;
+
+	bool sort_levels(const std::vector<uint32_t>& steps);
+	bool place_on_tree(int width, int k, std::vector<Maze::CellLocation>& starts);
+	void collect_top(uint32_t level, int k);
+};
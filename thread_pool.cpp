@@ -0,0 +1,111 @@
+#include <atomic>
+#include <memory>
+#include "thread_pool.h"
+
+int ThreadPool::hardware_threads()
+{
+	unsigned count = std::thread::hardware_concurrency();
+	return count > 0 ? (int)count : 1;
+}
+
+ThreadPool::ThreadPool(int num_threads) : m_stop(false)
+{
+	if (num_threads <= 0) num_threads = hardware_threads();
+	for (int i = 0; i < num_threads; i++)
+	{
+		m_threads.emplace_back(&ThreadPool::worker, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_tasks.push(std::move(task));
+	}
+	m_cond.notify_one();
+}
+
+void ThreadPool::worker()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty()) return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)>& func)
+{
+	struct State
+	{
+		std::atomic<int> next;
+		std::mutex mutex;
+		std::condition_variable done_cond;
+		int running = 0;
+		bool closed = false;
+	};
+
+	auto state = std::make_shared<State>();
+	state->next = 0;
+
+	// helpers that only get a thread after the loop is over must not touch func any more
+	auto helper = [state, count, &func]()
+	{
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			if (state->closed) return;
+			state->running++;
+		}
+		for (int i = state->next++; i < count; i = state->next++)
+		{
+			func(i);
+		}
+		std::unique_lock<std::mutex> lock(state->mutex);
+		if (--state->running == 0)
+		{
+			state->done_cond.notify_all();
+		}
+	};
+
+	int num_helpers = size() < count - 1 ? size() : count - 1;
+	for (int i = 0; i < num_helpers; i++)
+	{
+		submit(helper);
+	}
+
+	for (int i = state->next++; i < count; i = state->next++)
+	{
+		func(i);
+	}
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->closed = true;
+	state->done_cond.wait(lock, [&state]() { return state->running == 0; });
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+
+// Fixed set of worker threads consuming a queue of tasks
+class ThreadPool
+{
+public:
+	// num_threads <= 0 uses one thread per hardware thread
+	ThreadPool(int num_threads = 0);
+	~ThreadPool();
+
+	int size() const { return (int)m_threads.size(); }
+
+	void submit(std::function<void()> task);
+
+	// Runs func(i) for every i in [0, count) and returns when all are done.
+	// The calling thread takes part, so it is safe to call from a worker.
+	void parallel_for(int count, const std::function<void(int)>& func);
+
+	// process-wide pool, created on first use
+	static ThreadPool& shared();
+
+	static int hardware_threads();
+
+private:
+	std::vector<std::thread> m_threads;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop;
+
+	void worker();
+};